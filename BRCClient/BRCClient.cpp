@@ -3,81 +3,280 @@
 
 #include "BRCClient.h"
 
-bool BRCClient::beginBRCClient(const char *ssid, const char *passwd, const char *serverIP, const int port)
+/**
+ * @brief Write the time as 4 bytes big-endian.
+ */
+static void putTime(char *buffer, unsigned long time)
+{
+	buffer[0] = (char)(time >> 24);
+	buffer[1] = (char)(time >> 16);
+	buffer[2] = (char)(time >> 8);
+	buffer[3] = (char)time;
+}
+
+/**
+ * @brief Read the time of 4 bytes big-endian.
+ */
+static unsigned long getTime(const char *buffer)
+{
+	return (unsigned long)(uint8_t)buffer[0] << 24 | (unsigned long)(uint8_t)buffer[1] << 16 |
+	       (unsigned long)(uint8_t)buffer[2] << 8 | (uint8_t)buffer[3];
+}
+
+bool BRCClient::beginBRCClient(const char *ssid, const char *passwd, const char *serverIP, const int port,
+                               bool multiple)
 {
 	char joinedSSID[32];
 	memset(joinedSSID, 0, 32);
 
+	// Keep them for recover()
+	_ssid = ssid;
+	_passwd = passwd;
+	_serverIP = serverIP;
+	_serverPort = port;
+
 	// Check if the module joined an AP.
 	if (!joinedAP(joinedSSID) ||
 	    strcmp(joinedSSID, ssid) != 0) {
 		quitAP();
 		setMode(STATION);
-		multiConnect(false);
+		multiConnect(multiple);
 		if (joinAP(ssid, passwd) < 0)
 			return false;
-	}
-	if (beginClient("TCP", serverIP, port) != CONNECT_ERROR)
+	} else
+		multiConnect(multiple);
+
+	// A new connection starts with v1, and the acks of the old one never arrive.
+	_protocol = PROTOCOL_V1;
+	_rxLen = 0;
+	_rxHasSeq = false;
+	cancelRequests();
+	_lastAckSeq = 0;
+	_lastAckStatus = ACK_TIMEOUT;
+
+	_serverLink = multiple ? BRC_SERVER_LINK : LINK_SINGLE;
+	if (beginClient(_serverLink, "TCP", serverIP, port) >= CONNECT_OK)
 		return true;
 
 	return false;
 }
 
+bool BRCClient::recover()
+{
+	bool passthrough = isPassthrough(), udp = _udpEnabled, status;
+	bool v2 = _protocol == PROTOCOL_V2;
+
+	// Never connected
+	if (_ssid == NULL)
+		return false;
+
+	_recovering = true;
+	_udpEnabled = false;
+	status = hardReset() &&
+	         beginBRCClient(_ssid, _passwd, _serverIP, _serverPort, _serverLink != LINK_SINGLE) &&
+	         (!v2 || beginProtocolV2()) &&
+	         (_myID == 0xFF || registerID(_myID)) &&
+	         (!udp || beginUDPChannel(_udpIP, _udpPort)) &&
+	         (!passthrough || beginPassthrough());
+	_recovering = false;
+
+	return status;
+}
+
+void BRCClient::checkModule()
+{
+	if (_autoRecover && !_recovering &&
+	    consecutiveTimeouts() >= RECOVER_THRESHOLD)
+		recover();
+}
+
 bool BRCClient::endBRCClient()
 {
-	if (!endClient())
+	endUDPChannel();
+	if (!endPassthrough() || !endClient(_serverLink))
 		return false;
 	
 	quitAP();
 	return true;
 }
 
-bool BRCClient::sendMessage(CommMsg *msg)
+bool BRCClient::beginProtocolV2()
 {
-	char buffer[COMM_MSG_BUF_LEN + 2];
-	char *ch = buffer;
+	CommMsg msg = {
+		.type = MSG_PROTOCOL,
+		.ID = PROTOCOL_V2
+	};
 
-	// Add the type first.
-	*ch = msg->type;
+	_protocol = PROTOCOL_V1;
+	if (!sendMessage(&msg) || !receiveReply(&msg, MSG_PROTOCOL) ||
+	    msg.ID != PROTOCOL_V2 ||
+	    strcmp(msg.buffer, "OK") != 0)
+		return false;
 
-	switch (*ch++) {
+	_protocol = PROTOCOL_V2;
+	_txSeq = 0;
+	_rxLen = 0;
+	return true;
+}
+
+int8_t BRCClient::payloadLength(const CommMsg *msg, bool *hasID)
+{
+	*hasID = false;
+
+	switch (msg->type) {
 		case MSG_REGISTER:
-			*ch++ = msg->ID;
-			*ch = '\0';
-			break;
+		case MSG_PROTOCOL:
+			*hasID = true;
+			return 0;
 
-		case MSG_ROUND_COMPLETE:
+		case MSG_MAP_VERSION:
 			// No additional message
-			break;
+			return 0;
 
-		case MSG_CUSTOM:
-			*ch++ = msg->ID;
-			memcpy(ch, msg->buffer, COMM_MSG_BUF_LEN);
-			break;
+		case MSG_ROUND_COMPLETE:
+			// The time can contain null characters, which end a v1 message.
+			return _protocol == PROTOCOL_V2 ? TIME_LEN : 0;
+
+		case MSG_TIME_SYNC:
+			return TIME_LEN;
 
 		case MSG_REQUEST_RFID:
+			// The serial number is binary, it can contain null characters.
+			return 4;
+
+		case MSG_MAP_DUMP:
+			// [index of the first block: 2 bytes][number of frames]
+			return 3;
+
+		case MSG_CUSTOM:
+			*hasID = true;
+			return strnlen(msg->buffer, COMM_MSG_BUF_LEN - 1);
+
 		case MSG_CUSTOM_BROADCAST:
-			memcpy(ch, msg->buffer, COMM_MSG_BUF_LEN);
-			break;
+			return strnlen(msg->buffer, COMM_MSG_BUF_LEN - 1);
 
 		default:	// Invaild data type
-			return false;
+			return -1;
 	}
-
-	return puts(buffer);
 }
 
-bool BRCClient::receiveMessage(CommMsg *msg)
+int BRCClient::encodeMessage(CommMsg *msg, char *buffer)
 {
-	char buffer[COMM_MSG_BUF_LEN + 2];
 	char *ch = buffer;
+	int8_t len;
+	bool hasID;
+	uint16_t crc;
+
+	if ((len = payloadLength(msg, &hasID)) < 0)
+		return -1;
+
+	if (_protocol == PROTOCOL_V2) {
+		*ch++ = FRAME_MAGIC;
+		*ch++ = msg->type;
+		*ch++ = msg->ID;
+		*ch++ = (char)_txSeq++;
+		*ch++ = (char)len;
+		memcpy(ch, msg->buffer, len);
+		ch += len;
+		crc = frameCRC(buffer + 1, ch - buffer - 1);
+		*ch++ = (char)(crc >> 8);
+		*ch++ = (char)(crc & 0xFF);
+		return ch - buffer;
+	}
+
+	*ch++ = msg->type;
+	if (hasID)
+		*ch++ = msg->ID;
+	memcpy(ch, msg->buffer, len);
+	ch += len;
+	*ch = '\0';
+
+	return ch - buffer;
+}
+
+bool BRCClient::sendMessage(CommMsg *msg)
+{
+	char buffer[FRAME_MAX_LEN];
+	int len;
+
+	if ((len = encodeMessage(msg, buffer)) < 0)
+		return false;
+
+	if (puts(_serverLink, buffer, len))
+		return true;
+
+	checkModule();
+	return false;
+}
+
+bool BRCClient::beginBatch(char *buffer, unsigned int len)
+{
+	// The messages queued in the old buffer go first.
+	if (!flushMessages())
+		return false;
+
+	_batch = buffer;
+	_batchSize = len < BATCH_MAX_LEN ? len : BATCH_MAX_LEN;
+	return true;
+}
+
+bool BRCClient::queueMessage(CommMsg *msg)
+{
+	char buffer[FRAME_MAX_LEN];
+	int len;
+
+	// The v1 messages carry no length, so each of them goes by its own AT+CIPSEND.
+	if (_protocol == PROTOCOL_V1 || _batch == NULL)
+		return sendMessage(msg);
 
-	if (gets(buffer, COMM_MSG_BUF_LEN + 2) == -1)
+	if ((len = encodeMessage(msg, buffer)) < 0)
 		return false;
 
+	// Flush the queued messages if there is no room for the new one.
+	if (_batchLen + len > _batchSize && !flushMessages())
+		return false;
+	if ((unsigned int)len > _batchSize)
+		return sendMessage(msg);
+
+	if (_batchLen == 0)
+		_batchStart = millis();
+	memcpy(_batch + _batchLen, buffer, len);
+	_batchLen += len;
+
+	return true;
+}
+
+bool BRCClient::flushMessages()
+{
+	bool status;
+
+	if (_batchLen == 0)
+		return true;
+
+	status = puts(_serverLink, _batch, _batchLen);
+	_batchLen = 0;
+
+	if (!status)
+		checkModule();
+	return status;
+}
+
+bool BRCClient::pollBatch()
+{
+	if (_batchLen != 0 && millis() - _batchStart >= _batchDeadline)
+		return flushMessages();
+
+	return true;
+}
+
+bool BRCClient::decodeMessage(const char *buffer, CommMsg *msg)
+{
+	const char *ch = buffer;
+
 	msg->type = *ch;
 	switch (*ch++) {
 		case MSG_REGISTER:
+		case MSG_PROTOCOL:
 			msg->ID = *ch++;
 			memcpy(msg->buffer, ch, COMM_MSG_BUF_LEN);
 			break;
@@ -87,13 +286,21 @@ bool BRCClient::receiveMessage(CommMsg *msg)
 			memcpy(msg->buffer, ch, COMM_MSG_BUF_LEN);
 			break;
 
+		case MSG_MAP_VERSION:
+			msg->ID = *ch++;
+			memcpy(msg->buffer, ch, COMM_MSG_BUF_LEN);
+			break;
+
 		case MSG_ROUND_START:
 		case MSG_ROUND_END:
+		case MSG_TIME_SYNC:
 			msg->ID = *ch++;
+			memcpy(msg->buffer, ch, COMM_MSG_BUF_LEN);
 			break;
 
 		case MSG_CUSTOM:
 		case MSG_CUSTOM_BROADCAST:
+		case MSG_TELEMETRY:
 			msg->ID = *ch++;
 			memcpy(msg->buffer, ch, COMM_MSG_BUF_LEN);
 			break;
@@ -105,6 +312,292 @@ bool BRCClient::receiveMessage(CommMsg *msg)
 	return true;
 }
 
+bool BRCClient::receiveMessage(CommMsg *msg)
+{
+	pollRequests();
+
+	// The messages received while waiting come first.
+	if (_rxQueue && _rxQueue->pop(msg))
+		return true;
+
+	while (readMessage(msg)) {
+		if (!matchAck(msg))
+			return true;
+	}
+
+	return false;
+}
+
+bool BRCClient::readMessage(CommMsg *msg)
+{
+	// 1 more byte for the sequence number of UDP channel
+	char buffer[COMM_MSG_BUF_LEN + 3];
+	bool received = false;
+	MapMsg map;
+
+	pollBatch();
+	_rxHasSeq = false;
+
+	if (_protocol == PROTOCOL_V2)
+		received = receiveFrame(msg);
+	else if (gets(_serverLink, buffer, COMM_MSG_BUF_LEN + 2) != -1)
+		received = decodeMessage(buffer, msg);
+
+	// Datagram: [type][sequence number][the same as TCP]
+	if (!received && _udpEnabled &&
+	    gets(BRC_UDP_LINK, buffer, COMM_MSG_BUF_LEN + 3) != -1 &&
+	    acceptSequence((uint8_t)buffer[1])) {
+		buffer[1] = buffer[0];
+		received = decodeMessage(buffer + 1, msg);
+	}
+
+	// Keep every map data, including the ones requested by the other clients.
+	if (received && msg->type == MSG_REQUEST_RFID && _mapCache) {
+		map = rawDataToMapMsg(msg->buffer);
+		_mapCache->put(&map);
+	}
+
+	// The round changes before the message is queued.
+	if (received)
+		trackRound(msg);
+
+	return received;
+}
+
+bool BRCClient::receiveFrame(CommMsg *msg)
+{
+	uint8_t len = 0, need;
+	unsigned int n;
+	uint16_t crc;
+
+	for (;;) {
+		// Resync at the next FRAME_MAGIC.
+		if (_rxLen != 0 && _rxBuf[0] != FRAME_MAGIC) {
+			++_badFrames;
+			dropReceived(1);
+			continue;
+		}
+
+		need = FRAME_HEADER_LEN;
+		if (_rxLen >= FRAME_HEADER_LEN) {
+			len = (uint8_t)_rxBuf[4];
+			if (len > COMM_MSG_BUF_LEN - 1) {
+				++_badFrames;
+				dropReceived(1);
+				continue;
+			}
+			need += len + FRAME_CRC_LEN;
+		}
+
+		// Only the bytes of this frame are read, the rest of the +IPD frame is
+		// kept for the next one. The frame can also be split into several of them.
+		if (_rxLen < need) {
+			if ((n = read(_serverLink, _rxBuf + _rxLen, need - _rxLen)) == 0)
+				return false;
+			_rxLen += n;
+			continue;
+		}
+
+		crc = frameCRC(_rxBuf + 1, FRAME_HEADER_LEN - 1 + len);
+		if ((uint8_t)_rxBuf[FRAME_HEADER_LEN + len] == (crc >> 8) &&
+		    (uint8_t)_rxBuf[FRAME_HEADER_LEN + len + 1] == (crc & 0xFF))
+			break;
+
+		++_badFrames;
+		dropReceived(1);
+	}
+
+	memset(msg, 0, sizeof(CommMsg));
+	msg->type = _rxBuf[1];
+	msg->ID = _rxBuf[2];
+	_rxSeq = (uint8_t)_rxBuf[3];
+	_rxHasSeq = true;
+	memcpy(msg->buffer, _rxBuf + FRAME_HEADER_LEN, len);
+	dropReceived(need);
+
+	return true;
+}
+
+void BRCClient::dropReceived(uint8_t n)
+{
+	// Skip to the next FRAME_MAGIC as well.
+	while (n < _rxLen && _rxBuf[n] != FRAME_MAGIC)
+		++n;
+
+	_rxLen -= n;
+	memmove(_rxBuf, _rxBuf + n, _rxLen);
+}
+
+bool BRCClient::receiveReply(CommMsg *msg, char type)
+{
+	unsigned long start = millis();
+
+	do {
+		if (!readMessage(msg) || matchAck(msg))
+			continue;
+		if (msg->type == type)
+			return true;
+		holdMessage(msg);
+	} while (millis() - start < REPLY_TIMEOUT);
+
+	return false;
+}
+
+void BRCClient::holdMessage(const CommMsg *msg)
+{
+	if (!_rxQueue || !_rxQueue->push(msg))
+		++_dropped;
+}
+
+/**
+ * @brief Get the index of the message type in the handler table.
+ * @return -1 if the type can't have a handler.
+ */
+static int8_t handlerIndex(char type)
+{
+	switch (type) {
+		case MSG_REGISTER:         return 0;
+		case MSG_PROTOCOL:         return 1;
+		case MSG_REQUEST_RFID:     return 2;
+		case MSG_ROUND_START:      return 3;
+		case MSG_ROUND_END:        return 4;
+		case MSG_CUSTOM:           return 5;
+		case MSG_CUSTOM_BROADCAST: return 6;
+		case MSG_TELEMETRY:        return 7;
+		default:                   return -1;
+	}
+}
+
+bool BRCClient::onMessage(char type, MessageHandler handler)
+{
+	int8_t i = handlerIndex(type);
+
+	if (i < 0)
+		return false;
+
+	_handlers[i] = handler;
+	return true;
+}
+
+uint8_t BRCClient::dispatchMessages()
+{
+	CommMsg msg;
+	uint8_t count = 0;
+
+	// receiveMessage() takes the queued messages first.
+	// Stop at 255 so a flood of messages can't hold the loop forever.
+	while (count != 0xFF && receiveMessage(&msg)) {
+		dispatch(&msg);
+		++count;
+	}
+
+	return count;
+}
+
+void BRCClient::dispatch(const CommMsg *msg)
+{
+	MapMsg map;
+	int8_t i;
+
+	if (msg->type == MSG_REQUEST_RFID && _mapHandler) {
+		map = rawDataToMapMsg(msg->buffer);
+		_mapHandler(&map);
+	} else if ((i = handlerIndex(msg->type)) >= 0 && _handlers[i])
+		_handlers[i](msg);
+}
+
+int16_t BRCClient::sendRequest(CommMsg *msg)
+{
+	PendingRequest *req;
+
+	pollRequests();
+	if (_inFlight == ACK_WINDOW ||
+	    (msg->type != MSG_CUSTOM && msg->type != MSG_CUSTOM_BROADCAST))
+		return -1;
+
+	// v2 sends the sequence number in the frame, v1 only counts it.
+	req = &_requests[_inFlight];
+	req->seq = _txSeq;
+	req->type = msg->type;
+	if (!sendMessage(msg))
+		return -1;
+	if (_protocol == PROTOCOL_V1)
+		++_txSeq;
+
+	req->sentAt = millis();
+	++_inFlight;
+	return req->seq;
+}
+
+int8_t BRCClient::waitAck(uint8_t seq)
+{
+	CommMsg msg;
+	uint8_t i;
+
+	for (;;) {
+		for (i = 0; i < _inFlight && _requests[i].seq != seq; ++i)
+			;
+		if (i == _inFlight)
+			break;
+
+		pollRequests();
+		if (readMessage(&msg) && !matchAck(&msg))
+			holdMessage(&msg);
+	}
+
+	return _lastAckSeq == seq ? _lastAckStatus : ACK_TIMEOUT;
+}
+
+bool BRCClient::matchAck(const CommMsg *msg)
+{
+	uint8_t i;
+
+	if ((msg->type != MSG_CUSTOM && msg->type != MSG_CUSTOM_BROADCAST) ||
+	    (uint8_t)msg->ID != _myID ||
+	    (strcmp(msg->buffer, "OK") != 0 && strcmp(msg->buffer, "FAIL") != 0))
+		return false;
+
+	// v2: The ack has the sequence number of the request. The datagrams have none.
+	// v1: The server replies in order, so it's for the oldest request.
+	if (_protocol == PROTOCOL_V2 && !_rxHasSeq)
+		return false;
+	for (i = 0; i < _inFlight; ++i) {
+		if (_requests[i].type == msg->type &&
+		    (_protocol == PROTOCOL_V1 || _requests[i].seq == _rxSeq))
+			break;
+	}
+	if (i == _inFlight)
+		return false;
+
+	completeRequest(i, msg->buffer[0] == 'O' ? ACK_OK : ACK_FAIL);
+	return true;
+}
+
+void BRCClient::completeRequest(uint8_t index, int8_t status)
+{
+	_lastAckSeq = _requests[index].seq;
+	_lastAckStatus = status;
+
+	--_inFlight;
+	memmove(_requests + index, _requests + index + 1, (_inFlight - index) * sizeof(PendingRequest));
+
+	if (_ackCallback)
+		_ackCallback(_lastAckSeq, status);
+}
+
+void BRCClient::pollRequests()
+{
+	// The oldest request is timed out first.
+	while (_inFlight != 0 && millis() - _requests[0].sentAt >= _ackDeadline)
+		completeRequest(0, ACK_TIMEOUT);
+}
+
+void BRCClient::cancelRequests()
+{
+	while (_inFlight != 0)
+		completeRequest(0, ACK_TIMEOUT);
+}
+
 bool BRCClient::registerID(const uint8_t ID)
 {
 	// Invaild register ID
@@ -122,11 +615,12 @@ bool BRCClient::registerID(const uint8_t ID)
 	if (!sendMessage(&requestMsg))
 		return false;
 
-	// Wait for a moment and receive the reply from server
-	delay(10);
-	if (receiveMessage(&requestMsg) &&
+	// Receive the reply from server
+	if (receiveReply(&requestMsg, MSG_REGISTER) &&
 	    strcmp(requestMsg.buffer, "OK") == 0) {
 		_myID = ID;
+		if (_udpEnabled)
+			announceUDP();
 		return true;
 	} else
 		return false;
@@ -138,19 +632,13 @@ bool BRCClient::sendToClient(const uint8_t ID, const char *message)
 		.type = MSG_CUSTOM,
 		.ID = ID
 	};
-	strncpy(msg.buffer, message, COMM_MSG_BUF_LEN);
-	sendMessage(&msg);
+	int16_t seq;
 
-	// Delay for a while to receive the response
-	delay(1);
-	if (!receiveMessage(&msg))
+	strncpy(msg.buffer, message, COMM_MSG_BUF_LEN);
+	if ((seq = sendRequest(&msg)) < 0)
 		return false;
 
-	if (msg.ID == _myID &&
-		strcmp(msg.buffer, "OK") == 0)
-		return true;
-	else
-		return false;
+	return waitAck(seq) == ACK_OK;
 }
 
 bool BRCClient::broadcast(const char *message)
@@ -158,19 +646,195 @@ bool BRCClient::broadcast(const char *message)
 	CommMsg msg = {
 		.type = MSG_CUSTOM_BROADCAST
 	};
+	int16_t seq;
+
 	strncpy(msg.buffer, message, COMM_MSG_BUF_LEN);
-	sendMessage(&msg);
 
-	// Delay for a while to receive the response
-	delay(1);
-	if (!receiveMessage(&msg))
+	// Fire and forget
+	if (_udpEnabled)
+		return sendDatagram(&msg);
+
+	if ((seq = sendRequest(&msg)) < 0)
+		return false;
+
+	return waitAck(seq) == ACK_OK;
+}
+
+bool BRCClient::beginUDPChannel(const char *serverIP, const int port)
+{
+	// The UDP channel needs its own link.
+	if (_serverLink == LINK_SINGLE)
 		return false;
 
-	if (msg.ID == _myID &&
-		strcmp(msg.buffer, "OK") == 0)
+	// Keep them for recover()
+	_udpIP = serverIP;
+	_udpPort = port;
+
+	if (beginClient(BRC_UDP_LINK, "UDP", serverIP, port) < CONNECT_OK)
+		return false;
+
+	_udpEnabled = true;
+	_udpTxSeq = _udpRxSeq = 0;
+	_udpLost = 0;
+	_udpRejects = 0;
+	if (_myID != 0xFF)
+		announceUDP();
+	return true;
+}
+
+bool BRCClient::announceUDP()
+{
+	char buffer[3];
+
+	// The server learns the address of the channel from it.
+	buffer[0] = MSG_REGISTER;
+	buffer[1] = (char)_udpTxSeq++;
+	buffer[2] = (char)_myID;
+
+	return puts(BRC_UDP_LINK, buffer, 3);
+}
+
+bool BRCClient::endUDPChannel()
+{
+	if (!_udpEnabled)
 		return true;
-	else
+
+	_udpEnabled = false;
+	return endClient(BRC_UDP_LINK);
+}
+
+bool BRCClient::sendTelemetry(const char *data, uint8_t len)
+{
+	char buffer[COMM_MSG_BUF_LEN + 3];
+
+	if (!_udpEnabled || len > COMM_MSG_BUF_LEN)
 		return false;
+
+	// The data is sent as is, it can contain null characters.
+	buffer[0] = MSG_TELEMETRY;
+	buffer[1] = (char)_udpTxSeq++;
+	buffer[2] = (char)_myID;
+	memcpy(buffer + 3, data, len);
+
+	return puts(BRC_UDP_LINK, buffer, len + 3);
+}
+
+bool BRCClient::sendDatagram(CommMsg *msg)
+{
+	char buffer[COMM_MSG_BUF_LEN + 3];
+	int8_t len;
+	bool hasID;
+
+	// The datagrams are always in v1 with the sequence number after the type.
+	if ((len = payloadLength(msg, &hasID)) < 0)
+		return false;
+
+	buffer[0] = msg->type;
+	buffer[1] = (char)_udpTxSeq++;
+	if (hasID)
+		buffer[2] = msg->ID;
+	memcpy(buffer + 2 + hasID, msg->buffer, len);
+
+	if (puts(BRC_UDP_LINK, buffer, 2 + hasID + len))
+		return true;
+
+	checkModule();
+	return false;
+}
+
+bool BRCClient::acceptSequence(uint8_t seq)
+{
+	int8_t diff = (int8_t)(seq - _udpRxSeq);
+
+	// Duplicated or out of date datagram, unless the sender restarted its
+	// count or more than 127 datagrams were lost. Then the next ones are
+	// all behind, so follow the sender after a few of them in a row.
+	if (diff < 0 && ++_udpRejects < UDP_RESYNC_REJECTS)
+		return false;
+
+	if (diff > 0)
+		_udpLost += diff;
+	_udpRejects = 0;
+	_udpRxSeq = seq + 1;
+	return true;
+}
+
+bool BRCClient::findMapData(const uint8_t *sn, MapMsg *map)
+{
+	if (_mapImage.find(sn, map) || (_mapCache && _mapCache->get(sn, map))) {
+		trackTag(false);
+		return true;
+	}
+
+	requestMapData(sn);
+	return false;
+}
+
+bool BRCClient::downloadMap(MapStore *store)
+{
+	CommMsg msg;
+	MapMsg map;
+	uint16_t first = 0, total, count;
+	uint8_t i, frame;
+	bool status = true;
+
+	store->clear();
+	// The blocks contain null characters, which can't be sent in v1.
+	if (_protocol != PROTOCOL_V2)
+		return false;
+
+	do {
+		memset(&msg, 0, sizeof(msg));
+		msg.type = MSG_MAP_DUMP;
+		msg.buffer[0] = (char)(first >> 8);
+		msg.buffer[1] = (char)first;
+		msg.buffer[2] = MAP_DUMP_FRAMES;
+		if (!sendMessage(&msg))
+			return false;
+
+		for (frame = 0; frame < MAP_DUMP_FRAMES; ++frame) {
+			if (!receiveReply(&msg, MSG_MAP_DUMP) ||
+			    ((uint16_t)(uint8_t)msg.buffer[2] << 8 | (uint8_t)msg.buffer[3]) != first)
+				return false;
+
+			total = (uint16_t)(uint8_t)msg.buffer[0] << 8 | (uint8_t)msg.buffer[1];
+			count = total - first < MAP_DUMP_BLOCKS ? total - first : MAP_DUMP_BLOCKS;
+			for (i = 0; i < count; ++i) {
+				map = rawDataToMapMsg(msg.buffer + MAP_DUMP_HEADER_LEN + i * MAP_BLOCK_LEN);
+				status = store->add(&map) && status;
+			}
+
+			first += count;
+			if (first >= total)
+				break;
+		}
+	} while (first < total);
+
+	return status;
+}
+
+bool BRCClient::beginMapImage(const uint8_t *image, bool verify)
+{
+	MapImage candidate(image);
+	CommMsg msg = {
+		.type = MSG_MAP_VERSION
+	};
+	uint16_t version;
+
+	_mapImage = MapImage();
+	if (!candidate.valid())
+		return false;
+
+	if (verify) {
+		if (!sendMessage(&msg) || !receiveReply(&msg, MSG_MAP_VERSION))
+			return false;
+		version = (uint16_t)(uint8_t)msg.buffer[0] << 8 | (uint8_t)msg.buffer[1];
+		if (version != candidate.version())
+			return false;
+	}
+
+	_mapImage = candidate;
+	return true;
 }
 
 void BRCClient::requestMapData(const uint8_t *sn)
@@ -178,6 +842,8 @@ void BRCClient::requestMapData(const uint8_t *sn)
 	CommMsg msg = {
 		.type = MSG_REQUEST_RFID
 	};
+
+	trackTag(true);
 	memcpy(msg.buffer, sn, 4);
 	msg.buffer[4] = '\0';
 
@@ -185,12 +851,135 @@ void BRCClient::requestMapData(const uint8_t *sn)
 	delay(1);
 }
 
-void BRCClient::complete()
+bool BRCClient::complete()
 {
 	CommMsg msg = {
 		.type = MSG_ROUND_COMPLETE
 	};
 
-	sendMessage(&msg);
-	delay(1);
+	if (_roundState != ROUND_STARTED)
+		return false;
+
+	if (clockSynced())
+		putTime(msg.buffer, serverTime());
+	if (!sendMessage(&msg))
+		return false;
+
+	_roundState = ROUND_COMPLETED;
+	_round.completed = true;
+	_round.completeTime = millis() - _round.startTime;
+	return true;
+}
+
+void BRCClient::trackRound(const CommMsg *msg)
+{
+	unsigned long time;
+
+	if (msg->type != MSG_ROUND_START && msg->type != MSG_ROUND_END)
+		return;
+	if (!eventTime(msg, &time))
+		time = millis();
+
+	if (msg->type == MSG_ROUND_START) {
+		memset(&_round, 0, sizeof(_round));
+		_round.startTime = time;
+		_roundState = ROUND_STARTED;
+	} else if (_roundState == ROUND_STARTED || _roundState == ROUND_COMPLETED) {
+		_round.endTime = time - _round.startTime;
+		_roundState = ROUND_ENDED;
+	}
+}
+
+void BRCClient::trackTag(bool request)
+{
+	if (_roundState != ROUND_STARTED)
+		return;
+
+	if (_round.mapLookups++ == 0)
+		_round.firstTag = millis() - _round.startTime;
+	if (request)
+		++_round.mapRequests;
+}
+
+uint8_t BRCClient::syncClock(uint8_t samples)
+{
+	CommMsg msg;
+	unsigned long t0, t1, t2, t3;
+	int32_t d1, d2;
+	uint8_t count = 0;
+	bool replied;
+
+	// The timestamps are binary, which can't be sent in v1.
+	if (_protocol != PROTOCOL_V2)
+		return 0;
+
+	while (samples--) {
+		memset(&msg, 0, sizeof(msg));
+		msg.type = MSG_TIME_SYNC;
+		t0 = millis();
+		putTime(msg.buffer, t0);
+		if (!sendMessage(&msg))
+			continue;
+
+		// Skip the replies of the samples timed out before.
+		replied = false;
+		while (!replied && receiveReply(&msg, MSG_TIME_SYNC))
+			replied = getTime(msg.buffer) == t0;
+		t3 = millis();
+		if (!replied)
+			continue;
+
+		t1 = getTime(msg.buffer + TIME_LEN);
+		t2 = getTime(msg.buffer + 2 * TIME_LEN);
+		d1 = (int32_t)(t1 - t0);
+		d2 = (int32_t)(t2 - t3);
+
+		// Halve them first, since the difference of the clocks can be near 2^31.
+		_clockOffset[_clockNext] = d1 / 2 + d2 / 2 + (d1 % 2 + d2 % 2) / 2;
+		_clockRTT[_clockNext] = (t3 - t0) - (t2 - t1) > 0xFFFF ? 0xFFFF : (t3 - t0) - (t2 - t1);
+		_clockNext = (_clockNext + 1) % CLOCK_SAMPLES;
+		if (_clockSamples < CLOCK_SAMPLES)
+			++_clockSamples;
+		++count;
+	}
+
+	return count;
+}
+
+/**
+ * @brief Find the sample of the least round trip time.
+ */
+static uint8_t bestSample(const uint16_t *rtt, uint8_t samples)
+{
+	uint8_t best = 0;
+
+	for (uint8_t i = 1; i < samples; ++i) {
+		if (rtt[i] < rtt[best])
+			best = i;
+	}
+
+	return best;
+}
+
+int32_t BRCClient::clockOffset() const
+{
+	return _clockSamples != 0 ? _clockOffset[bestSample(_clockRTT, _clockSamples)] : 0;
+}
+
+unsigned long BRCClient::roundTripTime() const
+{
+	return _clockSamples != 0 ? _clockRTT[bestSample(_clockRTT, _clockSamples)] : 0;
+}
+
+bool BRCClient::eventTime(const CommMsg *msg, unsigned long *localTime) const
+{
+	unsigned long time;
+
+	if (!clockSynced() ||
+	    (msg->type != MSG_ROUND_START && msg->type != MSG_ROUND_END) ||
+	    (time = getTime(msg->buffer)) == 0)
+		return false;
+
+	*localTime = toLocalTime(time);
+	return true;
 }
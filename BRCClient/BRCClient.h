@@ -7,7 +7,97 @@
 
 #include <KSM111_ESP8266.h>
 #include "CommMsg.h"
+#include "MapCache.h"
+#include "MapImage.h"
 #include "MapMsg.h"
+#include "MapStore.h"
+#include "MsgQueue.h"
+
+/* The deadline of the reply from the server in milliseconds */
+#define REPLY_TIMEOUT 200
+
+/* The link ID of the BRC server in multiple connection mode */
+#define BRC_SERVER_LINK 0
+
+/* The link ID of the UDP channel to the BRC server */
+#define BRC_UDP_LINK 1
+/* The number of the datagrams behind the sequence number in a row to resync to them */
+#ifndef UDP_RESYNC_REJECTS
+ #define UDP_RESYNC_REJECTS 4
+#endif
+
+/* The number of the commands timed out in a row to recover the module */
+#define RECOVER_THRESHOLD 3
+
+/* Message batch */
+#define BATCH_MAX_LEN 2048	// The max size of the batch buffer, the limit of one AT+CIPSEND
+#define BATCH_DEADLINE  20	// The default time a message can wait in the batch in ms
+
+/* Request window. It sizes BRCClient, and BRCClient.cpp doesn't see the defines of the sketch, so change it here. */
+#define ACK_WINDOW   4	// The number of the requests waiting for their acks at most
+#define ACK_DEADLINE REPLY_TIMEOUT	// The default deadline of the ack in ms
+
+/* Status of the request */
+#define ACK_PENDING  0	// The ack hasn't arrived
+#define ACK_OK       1	// "OK" received
+#define ACK_FAIL    -1	// "FAIL" received, for example, the receiver isn't registered
+#define ACK_TIMEOUT -2	// No ack before the deadline, or the connection restarted
+
+/* The number of the message types which can have a handler */
+#define MSG_HANDLERS 8
+
+/* The number of the samples of the clock synchronization, the one of the least round trip time is used */
+#define CLOCK_SAMPLES 4
+
+/* The number of frames of a page of the map dump. The page is sent at once, so it has to fit in IPD_RING_SIZE. */
+#define MAP_DUMP_FRAMES 2
+
+/* State of the round */
+#define ROUND_IDLE      0	// No round has started
+#define ROUND_STARTED   1	// MSG_ROUND_START received
+#define ROUND_COMPLETED 2	// complete() called in the round
+#define ROUND_ENDED     3	// MSG_ROUND_END received
+
+/**
+ * @struct RoundMetrics BRCClient/BRCClient.h <BRCClient.h>
+ * @brief The metrics of a round. The times are in milliseconds from the start of the round.
+ */
+typedef struct RoundMetrics {
+	unsigned long startTime;	///< The time of the start in <tt>millis()</tt>, aligned to the server if the clock is synchronized
+	unsigned long firstTag;		///< The time of the first <tt>findMapData()</tt> or <tt>requestMapData()</tt>. Vaild if mapLookups != 0
+	unsigned long completeTime;	///< The time of <tt>complete()</tt>. Vaild if completed is true
+	unsigned long endTime;		///< The time of the end. Vaild if the state is ROUND_ENDED
+	uint16_t mapLookups;		///< The number of tags looked up
+	uint16_t mapRequests;		///< The number of map data requested from the server
+	bool completed;				///< Whether <tt>complete()</tt> is called in the round
+} RoundMetrics;
+
+/**
+ * @brief The function called when a request is acknowledged or timed out.
+ * @param seq The sequence number returned by <tt>BRCClient::sendRequest()</tt>.
+ * @param status ACK_OK, ACK_FAIL, or ACK_TIMEOUT.
+ */
+typedef void (*AckCallback)(uint8_t seq, int8_t status);
+
+/**
+ * @brief The function called with a message from the server by <tt>BRCClient::dispatchMessages()</tt>.
+ */
+typedef void (*MessageHandler)(const CommMsg *msg);
+
+/**
+ * @brief The function called with the map data by <tt>BRCClient::dispatchMessages()</tt>.
+ */
+typedef void (*MapHandler)(const MapMsg *map);
+
+/**
+ * @struct PendingRequest BRCClient/BRCClient.h <BRCClient.h>
+ * @brief A request waiting for its ack.
+ */
+typedef struct PendingRequest {
+	uint8_t seq;			///< The sequence number of the request
+	char type;				///< MSG_CUSTOM or MSG_CUSTOM_BROADCAST
+	unsigned long sentAt;	///< The time when the request was sent
+} PendingRequest;
 
 /**
  * @class BRCClient BRCClient.h <BRCClient.h>
@@ -20,33 +110,114 @@ class BRCClient : public KSM111_ESP8266
 		 * @brief Use <tt>SoftwareSerial</tt> to communicate with the module.
 		 */
 		BRCClient(int rxPin, int txPin, int resetPin = -1)
-			: KSM111_ESP8266(rxPin, txPin, resetPin), _myID(0xFF) {}
+			: KSM111_ESP8266(rxPin, txPin, resetPin), _myID(0xFF), _serverLink(LINK_SINGLE),
+			  _udpEnabled(false), _udpTxSeq(0), _udpRxSeq(0), _udpLost(0), _udpRejects(0),
+			  _ssid(NULL), _autoRecover(true), _recovering(false),
+			  _batch(NULL), _batchSize(0), _batchLen(0), _batchDeadline(BATCH_DEADLINE),
+			  _protocol(PROTOCOL_V1), _txSeq(0), _rxSeq(0), _rxHasSeq(false), _rxLen(0), _badFrames(0),
+			  _requests(), _inFlight(0), _ackDeadline(ACK_DEADLINE), _ackCallback(NULL),
+			  _lastAckSeq(0), _lastAckStatus(ACK_TIMEOUT),
+			  _rxQueue(NULL), _dropped(0), _handlers(), _mapHandler(NULL), _mapCache(NULL),
+			  _clockSamples(0), _clockNext(0), _roundState(ROUND_IDLE), _round() {}
 
 		/**
 		 * @brief For MEGA board, use <tt>HardwareSerial</tt> to communicate with the module.
 		 */
 		BRCClient(HardwareSerial *hws, int resetPin = -1)
-			: KSM111_ESP8266(hws, resetPin), _myID(0xFF) {}
+			: KSM111_ESP8266(hws, resetPin), _myID(0xFF), _serverLink(LINK_SINGLE),
+			  _udpEnabled(false), _udpTxSeq(0), _udpRxSeq(0), _udpLost(0), _udpRejects(0),
+			  _ssid(NULL), _autoRecover(true), _recovering(false),
+			  _batch(NULL), _batchSize(0), _batchLen(0), _batchDeadline(BATCH_DEADLINE),
+			  _protocol(PROTOCOL_V1), _txSeq(0), _rxSeq(0), _rxHasSeq(false), _rxLen(0), _badFrames(0),
+			  _requests(), _inFlight(0), _ackDeadline(ACK_DEADLINE), _ackCallback(NULL),
+			  _lastAckSeq(0), _lastAckStatus(ACK_TIMEOUT),
+			  _rxQueue(NULL), _dropped(0), _handlers(), _mapHandler(NULL), _mapCache(NULL),
+			  _clockSamples(0), _clockNext(0), _roundState(ROUND_IDLE), _round() {}
 
 		/**
 		 * @brief Join AP and connect to the BRC server.
 		 *
-		 * The module would be set to STATION mode, disable the multiple connections,
+		 * If the module hasn't joined the AP, it would be set to STATION mode,
 		 * and quit any joined AP. Then call <tt>joinAP()</tt> and <tt>beginClienet()</tt>
 		 * to join new AP and connect to the BRC server.
 		 *
+		 * In multiple connection mode, the BRC server is connected on link BRC_SERVER_LINK,
+		 * and the other links can be used by <tt>beginClient()</tt>, <tt>puts()</tt>, and
+		 * <tt>gets()</tt> with the link ID at the same time.
+		 *
 		 * @param ssid The ssid of AP.
 		 * @param passwd The password of AP.
 		 * @param serverIP The IP of the BRC server.
 		 * @param port The port of the BRC srever.
+		 * @param multiple [optional] true to enable the multiple connections.
+		 *
+		 * The strings are kept for <tt>recover()</tt>, so they must be valid
+		 * until <tt>endBRCClient()</tt>, for example, string literals.
 		 * @return true if the module successfully connects to the BRC server.
+		 *
+		 * @sa KSM111_ESP8266::beginPassthrough() to skip the AT+CIPSEND handshake of each message.
 		 */
-		bool beginBRCClient(const char *ssid, const char *passwd, const char *serverIP, const int port);
+		bool beginBRCClient(const char *ssid, const char *passwd, const char *serverIP, const int port,
+		                    bool multiple = false);
+
+		/**
+		 * @name Wire protocol v2
+		 * The length-prefixed frames with CRC. See CommMsg.h.
+		 *
+		 * The payload is sent in its exact length, so the binary data, like the serial number
+		 * in <tt>requestMapData()</tt>, is kept intact. The frames received in the same
+		 * +IPD frame are returned one by one, and the corrupted ones are dropped.
+		 */
+		/** @{ */
+		/**
+		 * @brief Ask the server to use the wire protocol v2 on this connection.
+		 *
+		 * Call it after <tt>beginBRCClient()</tt>. The connection keeps using v1
+		 * if the server doesn't support v2.
+		 *
+		 * @return true if the server accepts v2.
+		 */
+		bool beginProtocolV2();
+		/**
+		 * @brief Get the wire protocol in use, PROTOCOL_V1 or PROTOCOL_V2.
+		 */
+		uint8_t protocol() const { return _protocol; }
+		/**
+		 * @brief Get the number of the received v2 frames dropped for being corrupted.
+		 */
+		uint16_t badFrameCount() const { return _badFrames; }
+		/** @} */
+
+		/**
+		 * @brief Get the link ID of the BRC server.
+		 * @return BRC_SERVER_LINK in multiple connection mode, otherwise LINK_SINGLE.
+		 */
+		int8_t serverLink() const { return _serverLink; }
+
+		/**
+		 * @brief Reset the module and restore the connection to the BRC server.
+		 *
+		 * The module is reset by <tt>hardReset()</tt>. Then it joins the AP, connects to
+		 * the BRC server, registers the ID, opens the UDP channel, and enters the
+		 * passthrough mode again, if they were done before.
+		 *
+		 * If auto recovery is enabled, it is called when sending a message failed
+		 * after RECOVER_THRESHOLD commands timed out in a row.
+		 *
+		 * @return true if the connection is restored.
+		 */
+		bool recover();
+
+		/**
+		 * @brief Enable or disable the auto recovery. It's enabled by default.
+		 */
+		void setAutoRecover(bool enable) { _autoRecover = enable; }
 
 		/**
 		 * @brief Disconnect from the BRC server and quit from AP.
 		 *
-		 * This function will call <tt>endClient()</tt> and <tt>quitAP()</tt> in sequence.
+		 * This function will call <tt>endUDPChannel()</tt>, <tt>endPassthrough()</tt>,
+		 * <tt>endClient()</tt> and <tt>quitAP()</tt> in sequence.
 		 *
 		 * @return true if the module successfully quits from AP.
 		 */
@@ -59,6 +230,8 @@ class BRCClient : public KSM111_ESP8266
 		 * Therefore, the max number of vaild characters is COMM_MSG_BUF_LEN - 1,
 		 * which reserving 1 byte for a null-charater.
 		 *
+		 * In the passthrough mode, the message is written to the socket directly.
+		 *
 		 * @param msg The pointer to the container of the message.
 		 * @return true if the message is successfuly sent.
 		 */
@@ -66,11 +239,169 @@ class BRCClient : public KSM111_ESP8266
 
 		/**
 		 * @brief Receive a message from the server.
+		 *
+		 * The messages received while waiting for a reply or an ack are returned first.
+		 * The queued messages are also flushed if their deadline passed.
+		 * The acks of the requests in the window are taken by the window and not returned.
+		 *
 		 * @param msg The pointer to the container of the message,
 		 * @return true if there is an incoming message.
 		 */
 		bool receiveMessage(CommMsg *msg);
 
+		/**
+		 * @name Message dispatch
+		 * Call the handler of each message instead of switching on <tt>receiveMessage()</tt>.
+		 *
+		 * The messages received while waiting for a reply or an ack are kept in the receive
+		 * queue given by <tt>beginReceiveQueue()</tt>, so they are dispatched later. If there
+		 * is no queue or it's full, the message is dropped and counted by <tt>droppedCount()</tt>.
+		 */
+		/** @{ */
+		/**
+		 * @brief Give the receive queue. A <tt>MsgQueue<4></tt> takes 4 CommMsg.
+		 * @param queue The queue, or NULL to drop the messages received while waiting.
+		 *
+		 * The messages in the queue are kept across <tt>beginBRCClient()</tt> and
+		 * <tt>recover()</tt>. Call <tt>clear()</tt> of the queue to drop them.
+		 */
+		void beginReceiveQueue(MsgQueueBase *queue) { _rxQueue = queue; }
+		/**
+		 * @brief Set the handler of the message type.
+		 * @param type MSG_REGISTER, MSG_PROTOCOL, MSG_REQUEST_RFID, MSG_ROUND_START, MSG_ROUND_END,
+		 * MSG_CUSTOM, MSG_CUSTOM_BROADCAST, or MSG_TELEMETRY.
+		 * @param handler The handler, or NULL to remove it.
+		 * @return false if the type can't have a handler.
+		 */
+		bool onMessage(char type, MessageHandler handler);
+		void onRoundStart(MessageHandler handler) { onMessage(MSG_ROUND_START, handler); }
+		void onRoundEnd(MessageHandler handler) { onMessage(MSG_ROUND_END, handler); }
+		void onCustom(MessageHandler handler) { onMessage(MSG_CUSTOM, handler); }
+		void onBroadcast(MessageHandler handler) { onMessage(MSG_CUSTOM_BROADCAST, handler); }
+		/**
+		 * @brief Set the handler of the map data. It's called instead of the handler of MSG_REQUEST_RFID.
+		 */
+		void onMapData(MapHandler handler) { _mapHandler = handler; }
+		/**
+		 * @brief Call the handlers of the queued and the incoming messages.
+		 *
+		 * The messages without a handler are dropped. Call it in <tt>loop()</tt>.
+		 *
+		 * @return The number of dispatched messages.
+		 */
+		uint8_t dispatchMessages();
+		/**
+		 * @brief Get the number of the messages dropped for the receive queue being full or not given.
+		 */
+		uint16_t droppedCount() const { return _dropped; }
+		/** @} */
+
+		/**
+		 * @name Message batch
+		 * Send several messages by one AT+CIPSEND.
+		 *
+		 * Only the v2 frames are batched, which are sent back to back and
+		 * delimited by their length. In v1, a message has no length to be
+		 * split by, so <tt>queueMessage()</tt> sends it at once.
+		 *
+		 * The batch buffer is given by the sketch, so a sketch not batching
+		 * pays no memory for it.
+		 */
+		/** @{ */
+		/**
+		 * @brief Give the buffer for batching the messages.
+		 *
+		 * Until it's called, <tt>queueMessage()</tt> sends the message at once.
+		 * The messages queued in the old buffer are flushed first.
+		 *
+		 * @param buffer The buffer, or NULL to stop batching.
+		 * @param len The size of the buffer. At least FRAME_MAX_LEN bytes to batch
+		 *        any message, and at most BATCH_MAX_LEN bytes are used.
+		 * @return false if flushing the old buffer failed.
+		 */
+		bool beginBatch(char *buffer, unsigned int len);
+		/**
+		 * @brief Queue a message to be sent later. In v1 or without the batch buffer, it's sent now.
+		 *
+		 * The queued messages are flushed when the batch buffer is full,
+		 * <tt>flushMessages()</tt> is called, or the deadline passed and
+		 * <tt>pollBatch()</tt> or <tt>receiveMessage()</tt> is called.
+		 *
+		 * @param msg The pointer to the container of the message.
+		 * @return false if the type of message is invaild or flushing failed.
+		 */
+		bool queueMessage(CommMsg *msg);
+		/**
+		 * @brief Send all the queued messages now.
+		 * @return true if the messages are successfully sent or there is no queued message.
+		 */
+		bool flushMessages();
+		/**
+		 * @brief Flush the queued messages if the oldest one has waited for the deadline.
+		 * @return false if flushing failed.
+		 */
+		bool pollBatch();
+		/**
+		 * @brief Set how long a message can wait in the batch.
+		 * @param ms The deadline in milliseconds. Default is BATCH_DEADLINE.
+		 */
+		void setBatchDeadline(unsigned long ms) { _batchDeadline = ms; }
+		/** @} */
+
+		/**
+		 * @name Request window
+		 * Send MSG_CUSTOM and MSG_CUSTOM_BROADCAST without waiting for their acks.
+		 *
+		 * Each request gets a sequence number, and up to ACK_WINDOW requests can wait for
+		 * their acks at the same time. The acks are matched in <tt>receiveMessage()</tt>,
+		 * and the callback set by <tt>onAck()</tt> is invoked with the result.
+		 *
+		 * In v2, the server echoes the sequence number of the request in the ack.
+		 * In v1, the acks have no sequence number, so an ack is matched to the oldest
+		 * request of the same type.
+		 */
+		/** @{ */
+		/**
+		 * @brief Send the request and return without waiting for the ack.
+		 *
+		 * The request is always sent by TCP, even if the UDP channel is opened.
+		 *
+		 * @param msg The pointer to the container of the message.
+		 * @return The sequence number of the request.
+		 * @retval -1 The window is full, the type of message isn't MSG_CUSTOM or
+		 * MSG_CUSTOM_BROADCAST, or sending failed.
+		 */
+		int16_t sendRequest(CommMsg *msg);
+		/**
+		 * @brief Wait for the ack of the request.
+		 *
+		 * The other messages received in the meantime are kept in the receive queue.
+		 *
+		 * @param seq The sequence number returned by <tt>sendRequest()</tt>.
+		 * @return ACK_OK, ACK_FAIL, or ACK_TIMEOUT.
+		 */
+		int8_t waitAck(uint8_t seq);
+		/**
+		 * @brief Set the function called when a request is acknowledged or timed out.
+		 */
+		void onAck(AckCallback callback) { _ackCallback = callback; }
+		/**
+		 * @brief Set the deadline of the acks.
+		 * @param ms The deadline in milliseconds. Default is ACK_DEADLINE.
+		 */
+		void setAckDeadline(unsigned long ms) { _ackDeadline = ms; }
+		/**
+		 * @brief Get the number of the requests waiting for their acks.
+		 */
+		uint8_t inFlight() const { return _inFlight; }
+		/**
+		 * @brief Time out the requests whose deadline passed.
+		 *
+		 * It's called by <tt>receiveMessage()</tt> and <tt>sendRequest()</tt>.
+		 */
+		void pollRequests();
+		/** @} */
+
 		/**
 		 * @brief Register an ID representing itself on BRC server.
 		 *
@@ -87,6 +418,8 @@ class BRCClient : public KSM111_ESP8266
 		 * Note that the length of <tt>message</tt> can't be more than
 		 * COMM_MSG_BUF_LEN - 1, you have to reserve 1 byte for null-character.
 		 *
+		 * It's <tt>sendRequest()</tt> followed by <tt>waitAck()</tt>.
+		 *
 		 * @param ID The ID of the client who will receive the message.
 		 * @param message The buffer of the message
 		 */
@@ -98,10 +431,57 @@ class BRCClient : public KSM111_ESP8266
 		 * Note that the length of <tt>message</tt> can't be more than
 		 * COMM_MSG_BUF_LEN - 1, you have to reserve 1 byte for null-character.
 		 *
+		 * It's <tt>sendRequest()</tt> followed by <tt>waitAck()</tt>.
+		 * If the UDP channel is opened, the message is sent by it without waiting for
+		 * the reply, and it returns true once the message is handed to the module.
+		 *
 		 * @param message The buffer of the message
 		 */
 		bool broadcast(const char *message);
 
+		/**
+		 * @name UDP channel
+		 * The fire-and-forget channel for MSG_CUSTOM_BROADCAST and MSG_TELEMETRY.
+		 *
+		 * A datagram is [type][sequence number][the same bytes as TCP].
+		 * The sequence number increases by 1 for each datagram, so the receiver
+		 * can count the lost ones and drop the duplicated or out of date ones.
+		 * After UDP_RESYNC_REJECTS datagrams in a row are behind, the receiver
+		 * takes the sender's count, as the server restarted it.
+		 * The other messages are still sent by TCP.
+		 */
+		/** @{ */
+		/**
+		 * @brief Open the UDP channel to the BRC server on link BRC_UDP_LINK.
+		 *
+		 * Only available if the multiple connections are enabled in <tt>beginBRCClient()</tt>.
+		 * If the ID is registered, a MSG_REGISTER datagram is sent, so the server
+		 * can send the broadcasts to the client before it sends any telemetry.
+		 * Otherwise, it's sent by <tt>registerID()</tt>.
+		 *
+		 * @param serverIP The IP of the BRC server.
+		 * @param port The UDP port of the BRC server.
+		 * @return true if the channel is opened.
+		 */
+		bool beginUDPChannel(const char *serverIP, const int port);
+		/**
+		 * @brief Close the UDP channel.
+		 * @return true if the channel is closed.
+		 */
+		bool endUDPChannel();
+		/**
+		 * @brief Send the telemetry data, such as the position, by the UDP channel.
+		 * @param data The data. It can contain null characters.
+		 * @param len The length of the data. At most COMM_MSG_BUF_LEN bytes.
+		 * @return true if the datagram is handed to the module.
+		 */
+		bool sendTelemetry(const char *data, uint8_t len);
+		/**
+		 * @brief Get the number of the datagrams lost since the channel opened.
+		 */
+		uint16_t udpLostCount() const { return _udpLost; }
+		/** @} */
+
 		/**
 		 * @brief Request the map data of the specfied serial number.
 		 *
@@ -112,18 +492,388 @@ class BRCClient : public KSM111_ESP8266
 		 */
 		void requestMapData(const uint8_t *sn);
 
+		/**
+		 * @brief Find the map data of the serial number in the map image or the map cache, or request it.
+		 *
+		 * The map image set by <tt>beginMapImage()</tt> is checked first.
+		 * Every map data received from the server, including the ones requested by
+		 * the other clients, is kept in the cache given by <tt>beginMapCache()</tt>.
+		 * If the serial number isn't in either of them, <tt>requestMapData()</tt> is
+		 * called, and the map data arrives as usual.
+		 *
+		 * @param sn The buffer storing the 4-byte serial number.
+		 * @param map [out] The map data.
+		 * @return true if the map data is found in the cache.
+		 */
+		bool findMapData(const uint8_t *sn, MapMsg *map);
+
+		/**
+		 * @brief Give the cache of the map data received from the server.
+		 * @param cache The cache, or NULL to stop caching.
+		 */
+		void beginMapCache(MapCacheBase *cache) { _mapCache = cache; }
+
+		/**
+		 * @brief Get the map cache, for example, to clear it for a new map.
+		 * @return NULL if no cache is given.
+		 */
+		MapCacheBase *mapCache() { return _mapCache; }
+
+		/**
+		 * @brief Use the prebuilt map image in the flash memory for <tt>findMapData()</tt>.
+		 *
+		 * The version of the image is compared with the map of the server by MSG_MAP_VERSION.
+		 * If they are different, the image isn't used, and the map data is requested
+		 * from the server as before.
+		 *
+		 * @param image The image in PROGMEM generated by <tt>extras/mapimage/MapImageGen</tt>.
+		 * @param verify [optional] false to use the image without asking the server.
+		 * @return true if the image is used.
+		 */
+		bool beginMapImage(const uint8_t *image, bool verify = true);
+
+		/**
+		 * @brief Get the map image in use. It's not vaild if there is no image in use.
+		 */
+		const MapImage &mapImage() const { return _mapImage; }
+
+		/**
+		 * @brief Download the whole map from the server.
+		 *
+		 * Call it before the round starts, then the blocks are found in <tt>store</tt>
+		 * without requesting them from the server.
+		 *
+		 * The map is sent in pages of MAP_DUMP_FRAMES frames, so each page fits in
+		 * the receive buffers. The other messages received in the meantime are kept
+		 * in the receive queue. Only available in v2, see <tt>beginProtocolV2()</tt>.
+		 *
+		 * @param store [out] The map. It's cleared first.
+		 * @return true if all the blocks are received and stored. false if a block doesn't
+		 *         fit in <tt>store</tt>, but the rest of the map is still downloaded.
+		 */
+		bool downloadMap(MapStore *store);
+
 		/**
 		 * @brief Tell the server that the action has completed.
 		 *
-		 * Send MSG_ROUND_COMPLETE to the server.
+		 * Send MSG_ROUND_COMPLETE to the server with the time of the server
+		 * when it's called, or 0 if the clock isn't synchronized. In v1, only
+		 * the type is sent, the same as before the time was added.
+		 * It's only sent once in a round.
+		 *
+		 * @return false if the round isn't started, or it's already completed.
 		 */
-		void complete();
+		bool complete();
+
+		/**
+		 * @name Round
+		 * The state of the round: ROUND_IDLE, ROUND_STARTED, ROUND_COMPLETED, and ROUND_ENDED.
+		 *
+		 * MSG_ROUND_START and MSG_ROUND_END change the state as soon as they are read
+		 * from the module, even if they wait in the receive queue behind the other messages.
+		 * The times are the ones of the server if the clock is synchronized, see <tt>eventTime()</tt>.
+		 */
+		/** @{ */
+		/**
+		 * @brief Get the state of the round.
+		 */
+		uint8_t roundState() const { return _roundState; }
+		/**
+		 * @brief Get the metrics of the current round, or the last one if it ended.
+		 */
+		const RoundMetrics &roundMetrics() const { return _round; }
+		/** @} */
+
+		/**
+		 * @name Clock synchronization
+		 * Estimate the offset of the clock of the server in the way of NTP.
+		 *
+		 * Each sample is a MSG_TIME_SYNC exchange of 4 timestamps: t0 and t3 are
+		 * the time of the client when sending and receiving, and t1 and t2 are the
+		 * time of the server when receiving and replying. The round trip time is
+		 * (t3 - t0) - (t2 - t1), and the offset is ((t1 - t0) + (t2 - t3)) / 2.
+		 * The last CLOCK_SAMPLES samples are kept, and the offset of the one with
+		 * the least round trip time is used, since its delays are the most symmetric.
+		 */
+		/** @{ */
+		/**
+		 * @brief Take the samples of the clock of the server.
+		 *
+		 * Call it after <tt>beginProtocolV2()</tt>, and again from time to time
+		 * to follow the drift of the clocks. The timestamps are binary, so it's only
+		 * available in v2.
+		 *
+		 * @param samples [optional] The number of exchanges.
+		 * @return The number of successful exchanges. 0 in v1.
+		 */
+		uint8_t syncClock(uint8_t samples = CLOCK_SAMPLES);
+		/**
+		 * @brief Check if there is a sample of the clock of the server.
+		 */
+		bool clockSynced() const { return _clockSamples != 0; }
+		/**
+		 * @brief Get the offset of the clock of the server to <tt>millis()</tt> in milliseconds.
+		 */
+		int32_t clockOffset() const;
+		/**
+		 * @brief Get the round trip time of the sample in use in milliseconds.
+		 */
+		unsigned long roundTripTime() const;
+		/**
+		 * @brief Get the current time of the server in milliseconds.
+		 */
+		unsigned long serverTime() const { return millis() + clockOffset(); }
+		/**
+		 * @brief Convert the time of the server to <tt>millis()</tt>.
+		 */
+		unsigned long toLocalTime(unsigned long serverTime) const { return serverTime - clockOffset(); }
+		/**
+		 * @brief Get the time when MSG_ROUND_START or MSG_ROUND_END happened on the server.
+		 *
+		 * The latency of the network and the module isn't included.
+		 *
+		 * @param msg The message.
+		 * @param localTime [out] The time in <tt>millis()</tt>.
+		 * @return false if the clock isn't synchronized or the message has no time.
+		 */
+		bool eventTime(const CommMsg *msg, unsigned long *localTime) const;
+		/** @} */
 
 	private:
+		/**
+		 * @brief Get the payload of the message sent to the server.
+		 *
+		 * The payload is at the beginning of <tt>msg->buffer</tt>.
+		 *
+		 * @param msg The message.
+		 * @param hasID [out] Whether the ID is sent in v1.
+		 * @return The length of the payload.
+		 * @retval -1 The type of message is invaild.
+		 */
+		int8_t payloadLength(const CommMsg *msg, bool *hasID);
+
+		/**
+		 * @brief Convert the message to the bytes sent to the server in the wire protocol in use.
+		 * @param msg The message.
+		 * @param buffer [out] The buffer for the bytes. At least FRAME_MAX_LEN bytes.
+		 * @return The number of bytes to be sent. In v1, it's followed by a null character.
+		 * @retval -1 The type of message is invaild.
+		 */
+		int encodeMessage(CommMsg *msg, char *buffer);
+
+		/**
+		 * @brief Convert the bytes received from the server to the message.
+		 * @param buffer The bytes. At least COMM_MSG_BUF_LEN + 2 bytes.
+		 * @param msg [out] The message.
+		 * @return false if the type of message is invaild.
+		 */
+		bool decodeMessage(const char *buffer, CommMsg *msg);
+
+		/**
+		 * @brief Read the next message from the server and the UDP channel.
+		 * @param msg [out] The message.
+		 * @return true if there is an incoming message.
+		 */
+		bool readMessage(CommMsg *msg);
+
+		/**
+		 * @brief Take the next v2 frame from the server.
+		 *
+		 * The bytes of an incomplete frame are kept until the rest arrives.
+		 * After a broken length or CRC, the bytes are skipped to the next FRAME_MAGIC.
+		 *
+		 * @param msg [out] The message.
+		 * @return false if there is no vaild frame.
+		 */
+		bool receiveFrame(CommMsg *msg);
+
+		/**
+		 * @brief Drop the first <tt>n</tt> bytes of <tt>_rxBuf</tt> and the bytes before the next FRAME_MAGIC.
+		 */
+		void dropReceived(uint8_t n);
+
+		/**
+		 * @brief Send the message by the UDP channel.
+		 */
+		bool sendDatagram(CommMsg *msg);
+
+		/**
+		 * @brief Check the sequence number of the received datagram.
+		 * @return false if the datagram is duplicated or out of date.
+		 */
+		bool acceptSequence(uint8_t seq);
+
+		/**
+		 * @brief Tell the server the address of the UDP channel by a MSG_REGISTER datagram.
+		 */
+		bool announceUDP();
+
+		/**
+		 * @brief Call <tt>recover()</tt> if the module stops answering.
+		 */
+		void checkModule();
+
+		/**
+		 * @brief Wait for the reply from the server.
+		 *
+		 * The reply may not arrive immediately, especially in the passthrough mode
+		 * where a message ends after PASSTHROUGH_FRAME_GAP milliseconds.
+		 * The other messages received in the meantime are kept in the receive queue.
+		 *
+		 * @param msg [out] The reply.
+		 * @param type The type of the reply.
+		 * @return false if there is no reply in REPLY_TIMEOUT milliseconds.
+		 */
+		bool receiveReply(CommMsg *msg, char type);
+
+		/**
+		 * @brief Match the message to the request in the window.
+		 * @return true if the message is the ack of a request.
+		 */
+		bool matchAck(const CommMsg *msg);
+
+		/**
+		 * @brief Remove the request from the window and report the result.
+		 * @param index The index of the request in <tt>_requests</tt>.
+		 * @param status ACK_OK, ACK_FAIL, or ACK_TIMEOUT.
+		 */
+		void completeRequest(uint8_t index, int8_t status);
+
+		/**
+		 * @brief Time out all the requests in the window. The receive queue is kept.
+		 */
+		void cancelRequests();
+
+		/**
+		 * @brief Keep the message in the receive queue, or drop it if the queue is full.
+		 */
+		void holdMessage(const CommMsg *msg);
+
+		/**
+		 * @brief Call the handler of the message.
+		 */
+		void dispatch(const CommMsg *msg);
+
+		/**
+		 * @brief Update the state of the round by MSG_ROUND_START and MSG_ROUND_END.
+		 */
+		void trackRound(const CommMsg *msg);
+
+		/**
+		 * @brief Count the tag looked up in the round.
+		 * @param request Whether the map data is requested from the server.
+		 */
+		void trackTag(bool request);
+
 		/**
 		 * @brief The ID representing itself in the BRC server.
 		 */
 		uint8_t _myID;
+
+		/**
+		 * @brief The link ID of the BRC server.
+		 */
+		int8_t _serverLink;
+
+		/**
+		 * @name UDP channel
+		 */
+		/** @{ */
+		bool _udpEnabled;	///< Whether the UDP channel is opened
+		uint8_t _udpTxSeq;	///< The sequence number of the next sent datagram
+		uint8_t _udpRxSeq;	///< The expected sequence number of the next received datagram
+		uint16_t _udpLost;	///< The number of the lost datagrams
+		uint8_t _udpRejects;	///< The number of the datagrams behind <tt>_udpRxSeq</tt> in a row
+		/** @} */
+
+		/**
+		 * @name Recovery
+		 * The arguments of <tt>beginBRCClient()</tt> and <tt>beginUDPChannel()</tt>.
+		 */
+		/** @{ */
+		const char *_ssid;
+		const char *_passwd;
+		const char *_serverIP;
+		int _serverPort;
+		const char *_udpIP;
+		int _udpPort;
+		bool _autoRecover;	///< Whether <tt>recover()</tt> is called automatically
+		bool _recovering;	///< Whether <tt>recover()</tt> is in progress
+		/** @} */
+
+		/**
+		 * @name Message batch
+		 */
+		/** @{ */
+		char *_batch;					///< The queued messages. NULL if not batching
+		unsigned int _batchSize;		///< The size of <tt>_batch</tt>
+		unsigned int _batchLen;			///< The number of bytes in <tt>_batch</tt>
+		unsigned long _batchStart;		///< The time when the oldest message is queued
+		unsigned long _batchDeadline;	///< How long a message can wait in the batch
+		/** @} */
+
+		/**
+		 * @name Wire protocol
+		 */
+		/** @{ */
+		uint8_t _protocol;				///< PROTOCOL_V1 or PROTOCOL_V2
+		uint8_t _txSeq;					///< The sequence number of the next sent frame
+		uint8_t _rxSeq;					///< The sequence number of the last received frame
+		bool _rxHasSeq;					///< Whether the last read message is a v2 frame with <tt>_rxSeq</tt>
+		char _rxBuf[FRAME_MAX_LEN];		///< The bytes of the v2 frame being received
+		uint8_t _rxLen;					///< The number of bytes in <tt>_rxBuf</tt>
+		uint16_t _badFrames;			///< The number of the corrupted frames
+		/** @} */
+
+		/**
+		 * @name Request window
+		 */
+		/** @{ */
+		PendingRequest _requests[ACK_WINDOW];	///< The requests in the order of sending
+		uint8_t _inFlight;						///< The number of requests in <tt>_requests</tt>
+		unsigned long _ackDeadline;				///< The deadline of the acks
+		AckCallback _ackCallback;				///< The function called with the result
+		uint8_t _lastAckSeq;					///< The sequence number of the last completed request
+		int8_t _lastAckStatus;					///< The result of the last completed request
+		/** @} */
+
+		/**
+		 * @name Message dispatch
+		 */
+		/** @{ */
+		MsgQueueBase *_rxQueue;					///< The messages received while waiting
+		uint16_t _dropped;						///< The number of messages dropped by <tt>_rxQueue</tt>
+		MessageHandler _handlers[MSG_HANDLERS];	///< The handlers indexed by the message type
+		MapHandler _mapHandler;					///< The handler of the map data
+		/** @} */
+
+		/**
+		 * @brief The map data received from the server. NULL if not caching.
+		 */
+		MapCacheBase *_mapCache;
+
+		/**
+		 * @brief The prebuilt map.
+		 */
+		MapImage _mapImage;
+
+		/**
+		 * @name Clock synchronization
+		 */
+		/** @{ */
+		int32_t _clockOffset[CLOCK_SAMPLES];	///< The offsets of the samples
+		uint16_t _clockRTT[CLOCK_SAMPLES];		///< The round trip times of the samples
+		uint8_t _clockSamples;					///< The number of the samples
+		uint8_t _clockNext;						///< The next sample to be replaced
+		/** @} */
+
+		/**
+		 * @name Round
+		 */
+		/** @{ */
+		uint8_t _roundState;
+		RoundMetrics _round;
+		/** @} */
 };
 
 #endif
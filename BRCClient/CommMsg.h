@@ -1,21 +1,88 @@
 #ifndef _COMM_MSG_H_
 #define _COMM_MSG_H_
 
+#include <stdint.h>
+
 /**
  * @name Communication data type
  */
 /** @{ */
 #define MSG_REGISTER         (char)0x01
+#define MSG_PROTOCOL         (char)0x02
 #define MSG_REQUEST_RFID     (char)0x10
 #define MSG_ROUND_COMPLETE   (char)0x11
+#define MSG_MAP_DUMP         (char)0x12
+#define MSG_MAP_VERSION      (char)0x13
+#define MSG_TIME_SYNC        (char)0x14
 #define MSG_ROUND_START      (char)0x20
 #define MSG_ROUND_END        (char)0x21
 #define MSG_CUSTOM           (char)0x70
 #define MSG_CUSTOM_BROADCAST (char)0x71
+#define MSG_TELEMETRY        (char)0x72
 /** @} */
 
 #define COMM_MSG_BUF_LEN 30
 
+/**
+ * @name Wire protocol
+ *
+ * v1: [type][ID][payload], where ID only exists in MSG_REGISTER, MSG_PROTOCOL, and MSG_CUSTOM
+ * sent to the server. The length is decided by the type, and the text payload ends at the
+ * first null character.
+ *
+ * v2: [FRAME_MAGIC][type][ID][sequence number][length][payload][CRC high][CRC low].
+ * The payload is exactly <tt>length</tt> bytes, and the CRC-16/CCITT-FALSE covers
+ * from the type to the end of the payload.
+ * The reply of the server has the sequence number of the request.
+ *
+ * A connection starts with v1. v2 is used after the server accepts MSG_PROTOCOL
+ * with ID PROTOCOL_V2 by replying "OK".
+ */
+/** @{ */
+#define PROTOCOL_V1 1
+#define PROTOCOL_V2 2
+
+#define FRAME_MAGIC      (char)0xA5
+#define FRAME_HEADER_LEN 5
+#define FRAME_CRC_LEN    2
+#define FRAME_MAX_LEN    (FRAME_HEADER_LEN + COMM_MSG_BUF_LEN - 1 + FRAME_CRC_LEN)
+/** @} */
+
+/**
+ * @name Map dump
+ * The whole map in pages, only in v2.
+ *
+ * The request: MSG_MAP_DUMP with [index of the first block: 2 bytes][number of frames].
+ * The reply: the frames of MSG_MAP_DUMP with [total number of blocks: 2 bytes][index of the first block: 2 bytes]
+ * and up to MAP_DUMP_BLOCKS blocks of [sn: 4 bytes][x][y][type], the same as MSG_REQUEST_RFID.
+ * The numbers are big-endian. The server always sends at least one frame, so an empty map is a frame of 0 blocks.
+ *
+ * MSG_MAP_VERSION has no payload. The reply is [version: 2 bytes][number of blocks: 2 bytes],
+ * big-endian. See MapImage.h for the version.
+ */
+/** @{ */
+#define MAP_BLOCK_LEN   7
+#define MAP_DUMP_HEADER_LEN 4
+#define MAP_DUMP_BLOCKS ((COMM_MSG_BUF_LEN - 1 - MAP_DUMP_HEADER_LEN) / MAP_BLOCK_LEN)
+/** @} */
+
+/**
+ * @name Time
+ * The times are in milliseconds, 4 bytes big-endian. The time of the server
+ * counts from its start, and the time of the client is <tt>millis()</tt>.
+ *
+ * MSG_TIME_SYNC: the request is [t0: the time of the client when sending], and the reply is
+ * [t0][t1: the time of the server when receiving][t2: the time of the server when replying].
+ *
+ * MSG_ROUND_START and MSG_ROUND_END: [the time of the server when the round starts or ends].
+ *
+ * MSG_ROUND_COMPLETE: [the time of the server when the action completed, estimated by the client],
+ * or 0 if the clock isn't synchronized.
+ */
+/** @{ */
+#define TIME_LEN 4
+/** @} */
+
 /**
  * @struct COMM_MESSAGE BRCClient/CommMsg.h "CommMsg.h"
  * @brief The data structure for communicating with the central terminal.
@@ -26,4 +93,37 @@ typedef struct COMM_MESSAGE {
 	char buffer[COMM_MSG_BUF_LEN]; ///< The message buffer. Reserve 1 byte for null character.
 } CommMsg;
 
+/**
+ * @brief Calculate the CRC-16/CCITT-FALSE of the v2 frame.
+ * @param data The bytes from the type to the end of the payload.
+ * @param len The number of bytes.
+ * @param crc [optional] The CRC of the bytes before, to continue with.
+ */
+static inline uint16_t frameCRC(const char *data, uint8_t len, uint16_t crc = 0xFFFF)
+{
+	uint8_t i;
+
+	while (len--) {
+		crc ^= (uint16_t)(uint8_t)*data++ << 8;
+		for (i = 0; i < 8; ++i)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+
+	return crc;
+}
+
+/**
+ * @brief Add the block to the version of the map.
+ *
+ * The version of a map is the CRC-16/CCITT-FALSE of its blocks in the order of the
+ * serial number, starting from 0xFFFF. The server reports it by MSG_MAP_VERSION.
+ *
+ * @param version The version of the blocks before.
+ * @param block The block: [sn: 4 bytes][x][y][type].
+ */
+static inline uint16_t mapVersion(uint16_t version, const char *block)
+{
+	return frameCRC(block, MAP_BLOCK_LEN, version);
+}
+
 #endif //_COMM_MSG_H_
@@ -0,0 +1,60 @@
+#include <string.h>
+
+#include "MapCache.h"
+
+uint8_t MapCacheBase::homeSlot(const uint8_t *sn) const
+{
+	uint32_t key = (uint32_t)sn[0] << 24 | (uint32_t)sn[1] << 16 | (uint32_t)sn[2] << 8 | sn[3];
+
+	// Fibonacci hashing: the high bits of the product are well mixed.
+	return (uint8_t)((key * 2654435769UL) >> 24) & _mask;
+}
+
+void MapCacheBase::clear()
+{
+	memset(_used, 0, (_mask >> 3) + 1);
+	_size = 0;
+	_hits = _misses = 0;
+}
+
+int16_t MapCacheBase::find(const uint8_t *sn) const
+{
+	uint8_t i = homeSlot(sn);
+
+	for (uint8_t probe = 0; probe <= _mask; ++probe) {
+		if (!used(i) || memcmp(_blocks[i].sn, sn, 4) == 0)
+			return i;
+		i = (i + 1) & _mask;
+	}
+
+	return -1;
+}
+
+void MapCacheBase::put(const MapMsg *map)
+{
+	int16_t i = find(map->sn);
+
+	// Full, replace the block in the home slot.
+	if (i < 0)
+		i = homeSlot(map->sn);
+	else if (!used(i)) {
+		_used[i >> 3] |= 1 << (i & 7);
+		++_size;
+	}
+
+	_blocks[i] = *map;
+}
+
+bool MapCacheBase::get(const uint8_t *sn, MapMsg *map)
+{
+	int16_t i = find(sn);
+
+	if (i < 0 || !used(i)) {
+		++_misses;
+		return false;
+	}
+
+	*map = _blocks[i];
+	++_hits;
+	return true;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file BRCClient/MapCache.h
+ * @brief The header file of class MapCacheBase and class template MapCache
+ */
+#ifndef _MAP_CACHE_H_
+#define _MAP_CACHE_H_
+
+#include <stdint.h>
+
+#include "MapMsg.h"
+
+/**
+ * @class MapCacheBase BRCClient/MapCache.h "MapCache.h"
+ * @brief The fixed-memory hash table from the serial number to the map block.
+ *
+ * The table is open addressing with linear probing. The home slot is
+ * chosen by the multiplicative hash of the 4-byte serial number.
+ * If the table is full, the block in the home slot of the new one is replaced.
+ *
+ * The invaild blocks are also kept, so the unknown tags aren't requested again.
+ *
+ * The slots are given by the derived <tt>MapCache</tt>, so the caches of
+ * any capacity are used through this class.
+ */
+class MapCacheBase
+{
+	public:
+		/**
+		 * @brief Drop all the blocks.
+		 */
+		void clear();
+
+		/**
+		 * @brief Add the block, or update it if the serial number is already in the cache.
+		 */
+		void put(const MapMsg *map);
+
+		/**
+		 * @brief Find the block of the serial number.
+		 * @param sn The 4-byte serial number.
+		 * @param map [out] The block.
+		 * @return true if the serial number is in the cache.
+		 */
+		bool get(const uint8_t *sn, MapMsg *map);
+
+		/**
+		 * @brief Get the number of the blocks in the cache.
+		 */
+		uint8_t size() const { return _size; }
+		uint8_t capacity() const { return _mask + 1; }
+
+		/**
+		 * @brief Get the number of the lookups found in the cache, and not.
+		 */
+		uint16_t hits() const { return _hits; }
+		uint16_t misses() const { return _misses; }
+
+	protected:
+		/**
+		 * @param blocks The slots.
+		 * @param used The bitmap of the occupied slots, 1 bit per slot.
+		 * @param capacity The number of the slots. Must be a power of 2, at most 128.
+		 */
+		MapCacheBase(MapMsg *blocks, uint8_t *used, uint8_t capacity)
+			: _blocks(blocks), _used(used), _mask(capacity - 1) { clear(); }
+
+	private:
+		// The slots belong to the derived cache, so it can't be copied.
+		MapCacheBase(const MapCacheBase &);
+		MapCacheBase &operator=(const MapCacheBase &);
+
+		/**
+		 * @brief Get the home slot of the serial number.
+		 */
+		uint8_t homeSlot(const uint8_t *sn) const;
+
+		/**
+		 * @brief Find the slot of the serial number, or the empty slot for it.
+		 * @return The index of the slot. -1 if the serial number isn't in the full table.
+		 */
+		int16_t find(const uint8_t *sn) const;
+
+		bool used(uint8_t i) const { return _used[i >> 3] & (1 << (i & 7)); }
+
+		MapMsg *_blocks;
+		uint8_t *_used;		///< The bitmap of the occupied slots
+		uint8_t _mask;		///< The capacity - 1
+		uint8_t _size;
+		uint16_t _hits;
+		uint16_t _misses;
+};
+
+/**
+ * @class MapCache BRCClient/MapCache.h "MapCache.h"
+ * @brief The MapCacheBase with its <tt>N</tt> slots.
+ *
+ * Each block takes 7 bytes, plus 1 bit for the occupancy.
+ *
+ * @tparam N The capacity. Must be a power of 2, at most 128.
+ */
+template <uint8_t N>
+class MapCache : public MapCacheBase
+{
+	static_assert(N != 0 && (N & (N - 1)) == 0 && N <= 128, "N must be a power of 2, at most 128");
+
+	public:
+		MapCache() : MapCacheBase(_slots, _bitmap, N) {}
+
+	private:
+		MapMsg _slots[N];
+		uint8_t _bitmap[(N + 7) / 8];
+};
+
+#endif // _MAP_CACHE_H_
@@ -0,0 +1,62 @@
+#include "MapImage.h"
+
+uint16_t MapImage::readWord(uint8_t offset) const
+{
+	return (uint16_t)pgm_read_byte(_image + offset) << 8 | pgm_read_byte(_image + offset + 1);
+}
+
+bool MapImage::valid() const
+{
+	return _image != NULL &&
+	       pgm_read_byte(_image) == MAP_IMAGE_MAGIC_0 &&
+	       pgm_read_byte(_image + 1) == MAP_IMAGE_MAGIC_1;
+}
+
+uint16_t MapImage::version() const
+{
+	return valid() ? readWord(2) : 0;
+}
+
+uint16_t MapImage::size() const
+{
+	return valid() ? readWord(4) : 0;
+}
+
+int8_t MapImage::compare(uint16_t index, const uint8_t *sn) const
+{
+	const uint8_t *block = _image + MAP_IMAGE_HEADER_LEN + index * MAP_BLOCK_LEN;
+	uint8_t b;
+
+	for (uint8_t i = 0; i < 4; ++i) {
+		b = pgm_read_byte(block + i);
+		if (b != sn[i])
+			return b < sn[i] ? -1 : 1;
+	}
+
+	return 0;
+}
+
+bool MapImage::find(const uint8_t *sn, MapMsg *map) const
+{
+	const uint8_t *block;
+	uint16_t low = 0, high = size(), mid;
+	int8_t cmp;
+
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if ((cmp = compare(mid, sn)) == 0) {
+			block = _image + MAP_IMAGE_HEADER_LEN + mid * MAP_BLOCK_LEN;
+			memcpy(map->sn, sn, 4);
+			map->x = (int8_t)pgm_read_byte(block + 4);
+			map->y = (int8_t)pgm_read_byte(block + 5);
+			map->type = (char)pgm_read_byte(block + 6);
+			return true;
+		}
+		if (cmp < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return false;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file BRCClient/MapImage.h
+ * @brief The header file of class MapImage
+ */
+#ifndef _MAP_IMAGE_H_
+#define _MAP_IMAGE_H_
+
+#include <Arduino.h>
+
+#include "CommMsg.h"
+#include "MapMsg.h"
+
+/**
+ * @name Map image
+ * The map stored in the flash memory, generated by <tt>extras/mapimage/MapImageGen</tt>.
+ *
+ * ['B']['M'][version: 2 bytes][number of blocks: 2 bytes] followed by the blocks of
+ * [sn: 4 bytes][x][y][type], sorted by the serial number. The numbers are big-endian.
+ *
+ * The version is <tt>mapVersion()</tt> of the blocks, so it changes with the map.
+ */
+/** @{ */
+#define MAP_IMAGE_MAGIC_0    'B'
+#define MAP_IMAGE_MAGIC_1    'M'
+#define MAP_IMAGE_HEADER_LEN 6
+/** @} */
+
+/**
+ * @class MapImage BRCClient/MapImage.h "MapImage.h"
+ * @brief The reader of the map image in PROGMEM.
+ *
+ * The blocks are found by the binary search in the flash memory,
+ * so the map takes no SRAM. The image must be in the first 64 KB of the flash.
+ */
+class MapImage
+{
+	public:
+		/**
+		 * @param image The image in PROGMEM, or NULL for no image.
+		 */
+		MapImage(const uint8_t *image = NULL) : _image(image) {}
+
+		/**
+		 * @brief Check the magic number of the image.
+		 */
+		bool valid() const;
+
+		/**
+		 * @brief Get the version of the map. 0 if the image isn't vaild.
+		 */
+		uint16_t version() const;
+
+		/**
+		 * @brief Get the number of the blocks. 0 if the image isn't vaild.
+		 */
+		uint16_t size() const;
+
+		/**
+		 * @brief Find the block of the serial number.
+		 * @param sn The 4-byte serial number.
+		 * @param map [out] The block.
+		 * @return true if the serial number is in the image.
+		 */
+		bool find(const uint8_t *sn, MapMsg *map) const;
+
+	private:
+		/**
+		 * @brief Read the big-endian 16-bit number in the image.
+		 */
+		uint16_t readWord(uint8_t offset) const;
+
+		/**
+		 * @brief Compare the serial number of the block with <tt>sn</tt>, like <tt>memcmp()</tt>.
+		 */
+		int8_t compare(uint16_t index, const uint8_t *sn) const;
+
+		const uint8_t *_image;
+};
+
+#endif // _MAP_IMAGE_H_
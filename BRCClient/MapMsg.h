@@ -40,7 +40,7 @@ typedef struct MAP_MESSAGE {
  *
  * @rawData The pointer to the buffer of raw data. Must be null terminated.
  */
-static MapMsg rawDataToMapMsg(const char * const rawData)
+static inline MapMsg rawDataToMapMsg(const char * const rawData)
 {
 	const char *ch = rawData;
 	MapMsg mapMsg;
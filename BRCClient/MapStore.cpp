@@ -0,0 +1,113 @@
+#include <string.h>
+
+#include "MapStore.h"
+
+#if MAP_GRID_W * MAP_GRID_H > 256
+ #error "The map grid has at most 256 cells"
+#endif
+
+#if MAP_INDEX_LEN > 255
+ #error "MAP_INDEX_LEN must be at most 255"
+#endif
+
+/* The block types by their 4-bit code. Code 0 is no block. */
+static const char TYPES[] = {
+	MAP_INVAILD, MAP_NORMAL, MAP_TREASURE, MAP_PARK_1, MAP_PARK_2, MAP_PARK_3, MAP_PARK_4
+};
+#define TYPE_CODES (sizeof(TYPES) / sizeof(TYPES[0]))
+
+static uint8_t typeCode(char type)
+{
+	for (uint8_t i = 1; i < TYPE_CODES; ++i) {
+		if (TYPES[i] == type)
+			return i;
+	}
+
+	return 0;
+}
+
+void MapStore::clear()
+{
+	memset(_grid, 0, sizeof(_grid));
+	_size = 0;
+}
+
+uint8_t MapStore::lowerBound(const uint8_t *sn) const
+{
+	uint8_t low = 0, high = _size, mid;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (memcmp(_index[mid].sn, sn, 4) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+bool MapStore::add(const MapMsg *map)
+{
+	uint8_t i, cell;
+
+	if (map->x < 0 || map->x >= MAP_GRID_W || map->y < 0 || map->y >= MAP_GRID_H)
+		return false;
+
+	cell = map->y * MAP_GRID_W + map->x;
+	// A cell holds one block, so the other block in it is replaced.
+	for (i = 0; i < _size; ++i) {
+		if (_index[i].cell == cell && memcmp(_index[i].sn, map->sn, 4) != 0) {
+			--_size;
+			memmove(_index + i, _index + i + 1, (_size - i) * sizeof(IndexEntry));
+			break;
+		}
+	}
+
+	i = lowerBound(map->sn);
+	if (i == _size || memcmp(_index[i].sn, map->sn, 4) != 0) {
+		if (_size == MAP_INDEX_LEN)
+			return false;
+		memmove(_index + i + 1, _index + i, (_size - i) * sizeof(IndexEntry));
+		memcpy(_index[i].sn, map->sn, 4);
+		++_size;
+	} else if (_index[i].cell != cell)
+		setType(_index[i].cell, 0);	// The block moved, so its old cell is empty.
+	_index[i].cell = cell;
+	setType(cell, typeCode(map->type));
+
+	return true;
+}
+
+void MapStore::setType(uint8_t cell, uint8_t code)
+{
+	if (cell & 1)
+		_grid[cell / 2] = (_grid[cell / 2] & 0x0F) | code << 4;
+	else
+		_grid[cell / 2] = (_grid[cell / 2] & 0xF0) | code;
+}
+
+char MapStore::typeAt(int8_t x, int8_t y) const
+{
+	uint8_t cell;
+
+	if (x < 0 || x >= MAP_GRID_W || y < 0 || y >= MAP_GRID_H)
+		return MAP_INVAILD;
+
+	cell = y * MAP_GRID_W + x;
+	return TYPES[(cell & 1) ? _grid[cell / 2] >> 4 : _grid[cell / 2] & 0x0F];
+}
+
+bool MapStore::find(const uint8_t *sn, MapMsg *map) const
+{
+	uint8_t i = lowerBound(sn);
+
+	if (i == _size || memcmp(_index[i].sn, sn, 4) != 0)
+		return false;
+
+	memcpy(map->sn, sn, 4);
+	map->x = _index[i].cell % MAP_GRID_W;
+	map->y = _index[i].cell / MAP_GRID_W;
+	map->type = typeAt(map->x, map->y);
+	return true;
+}
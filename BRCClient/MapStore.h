@@ -0,0 +1,102 @@
+/**
+ * @file BRCClient/MapStore.h
+ * @brief The header file of class MapStore
+ */
+#ifndef _MAP_STORE_H_
+#define _MAP_STORE_H_
+
+#include <stdint.h>
+
+#include "MapMsg.h"
+
+/**
+ * @name Map grid
+ * The size of the grid. The blocks at x from 0 to MAP_GRID_W - 1 and
+ * y from 0 to MAP_GRID_H - 1 can be stored. At most 256 cells.
+ * MapStore.cpp doesn't see the defines of the sketch, so change them here.
+ */
+/** @{ */
+#define MAP_GRID_W 16
+#define MAP_GRID_H 16
+/** @} */
+
+/**
+ * @brief The number of the blocks in the serial number index.
+ *
+ * Each block takes 5 bytes. Reduce it here on UNO if the map is small.
+ */
+#define MAP_INDEX_LEN 100
+
+/**
+ * @class MapStore BRCClient/MapStore.h "MapStore.h"
+ * @brief The whole map: the grid of the block types and the sorted index of the serial numbers.
+ *
+ * The type of each cell takes 4 bits, so the type of a position is found in O(1).
+ * The index is sorted by the serial number, so the block of a tag is found
+ * by the binary search in O(log n).
+ *
+ * It's filled by <tt>BRCClient::downloadMap()</tt>.
+ */
+class MapStore
+{
+	public:
+		MapStore() { clear(); }
+
+		/**
+		 * @brief Drop all the blocks.
+		 */
+		void clear();
+
+		/**
+		 * @brief Add the block, or update it if the serial number is already in the index.
+		 *
+		 * If the block moves, its old cell is emptied. The other block in its cell is removed.
+		 *
+		 * @return false if the block is out of the grid or the index is full.
+		 */
+		bool add(const MapMsg *map);
+
+		/**
+		 * @brief Get the type of the block at the position.
+		 * @return MAP_INVAILD if there is no block.
+		 */
+		char typeAt(int8_t x, int8_t y) const;
+
+		/**
+		 * @brief Find the block of the serial number.
+		 * @param sn The 4-byte serial number.
+		 * @param map [out] The block.
+		 * @return true if the serial number is in the index.
+		 */
+		bool find(const uint8_t *sn, MapMsg *map) const;
+
+		/**
+		 * @brief Get the number of the blocks.
+		 */
+		uint8_t size() const { return _size; }
+
+	private:
+		/**
+		 * @brief A block in the index. The cell is y * MAP_GRID_W + x.
+		 */
+		struct IndexEntry {
+			uint8_t sn[4];
+			uint8_t cell;
+		};
+
+		/**
+		 * @brief Find the first entry whose serial number isn't less than <tt>sn</tt>.
+		 */
+		uint8_t lowerBound(const uint8_t *sn) const;
+
+		/**
+		 * @brief Set the 4-bit type code of the cell. Code 0 is no block.
+		 */
+		void setType(uint8_t cell, uint8_t code);
+
+		uint8_t _grid[(MAP_GRID_W * MAP_GRID_H + 1) / 2];	///< The type codes, 2 cells per byte
+		IndexEntry _index[MAP_INDEX_LEN];					///< Sorted by the serial number
+		uint8_t _size;
+};
+
+#endif // _MAP_STORE_H_
@@ -0,0 +1,108 @@
+/**
+ * @file BRCClient/MsgQueue.h
+ * @brief The header file of class MsgQueueBase and class template MsgQueue
+ */
+#ifndef _MSG_QUEUE_H_
+#define _MSG_QUEUE_H_
+
+#include <stdint.h>
+
+#include "CommMsg.h"
+
+/**
+ * @class MsgQueueBase BRCClient/MsgQueue.h "MsgQueue.h"
+ * @brief The fixed-capacity single-producer/single-consumer ring of CommMsg.
+ *
+ * The producer only moves the tail and the consumer only moves the head,
+ * so one of them can run in an interrupt without disabling it.
+ * The indices run freely and wrap around, so all the slots are used.
+ *
+ * The slots are given by the derived <tt>MsgQueue</tt>, so the queues of
+ * any capacity are used through this class.
+ */
+class MsgQueueBase
+{
+	public:
+		/**
+		 * @brief Put the message at the tail. Called by the producer.
+		 * @return false if the queue is full.
+		 */
+		bool push(const CommMsg *msg)
+		{
+			uint8_t tail = _tail;
+
+			if ((uint8_t)(tail - _head) == capacity())
+				return false;
+
+			_msgs[tail & _mask] = *msg;
+			_tail = tail + 1;
+			return true;
+		}
+
+		/**
+		 * @brief Take the message at the head. Called by the consumer.
+		 * @return false if the queue is empty.
+		 */
+		bool pop(CommMsg *msg)
+		{
+			uint8_t head = _head;
+
+			if (head == _tail)
+				return false;
+
+			*msg = _msgs[head & _mask];
+			_head = head + 1;
+			return true;
+		}
+
+		/**
+		 * @brief Get the number of the queued messages.
+		 */
+		uint8_t size() const { return _tail - _head; }
+		uint8_t capacity() const { return _mask + 1; }
+		bool empty() const { return _head == _tail; }
+		bool full() const { return size() == capacity(); }
+
+		/**
+		 * @brief Drop all the queued messages. Called by the consumer.
+		 */
+		void clear() { _head = _tail; }
+
+	protected:
+		/**
+		 * @param msgs The slots.
+		 * @param capacity The number of the slots. Must be a power of 2, at most 128.
+		 */
+		MsgQueueBase(CommMsg *msgs, uint8_t capacity)
+			: _msgs(msgs), _mask(capacity - 1), _head(0), _tail(0) {}
+
+	private:
+		// The slots belong to the derived queue, so it can't be copied.
+		MsgQueueBase(const MsgQueueBase &);
+		MsgQueueBase &operator=(const MsgQueueBase &);
+
+		CommMsg *_msgs;
+		uint8_t _mask;			///< The capacity - 1
+		volatile uint8_t _head;	///< The next message to be popped
+		volatile uint8_t _tail;	///< The next slot to be pushed
+};
+
+/**
+ * @class MsgQueue BRCClient/MsgQueue.h "MsgQueue.h"
+ * @brief The MsgQueueBase with its <tt>N</tt> slots.
+ *
+ * @tparam N The capacity. Must be a power of 2, at most 128.
+ */
+template <uint8_t N>
+class MsgQueue : public MsgQueueBase
+{
+	static_assert(N != 0 && (N & (N - 1)) == 0 && N <= 128, "N must be a power of 2, at most 128");
+
+	public:
+		MsgQueue() : MsgQueueBase(_slots, N) {}
+
+	private:
+		CommMsg _slots[N];
+};
+
+#endif // _MSG_QUEUE_H_
@@ -0,0 +1,98 @@
+/* Print the messages from the server by the handlers of
+ * their types instead of switching on receiveMessage().
+ */
+
+#include <BRCClient.h>
+
+/* If you are using UNO, uncomment the next line. */
+// #define UNO
+/* If you are using MEGA and want to use HardwareSerial,
+ * umcomment the next 2 lines. */
+// #define USE_HARDWARE_SERIAL
+// #define HW_SERIAL Serial3
+
+#ifdef UNO
+ #define UART_RX 3
+ #define UART_TX 2
+#else
+ #define UART_RX 10
+ #define UART_TX 2
+#endif
+
+#if !defined(UNO) && defined(USE_HARDWARE_SERIAL)
+ BRCClient brcClient(&HW_SERIAL);
+#else
+ BRCClient brcClient(UART_RX, UART_TX);
+#endif
+
+// You have to modify the corresponding parameter
+#define AP_SSID    "AP_SSID"
+#define AP_PASSWD  "AP_PASSWD"
+#define TCP_IP     "TCP_IP"
+#define TCP_PORT   5000
+#define MY_COMM_ID (char)0x24
+
+// Keep up to 4 messages received while waiting for a reply.
+MsgQueue<4> rxQueue;
+
+void printRoundStart(const CommMsg *msg)
+{
+	Serial.println("Round start");
+}
+
+void printRoundEnd(const CommMsg *msg)
+{
+	Serial.println("Round end");
+}
+
+void printMapData(const MapMsg *map)
+{
+	Serial.print("Block (");
+	Serial.print(map->x);
+	Serial.print(", ");
+	Serial.print(map->y);
+	Serial.print(") type ");
+	Serial.println((uint8_t)map->type, HEX);
+}
+
+void printCustom(const CommMsg *msg)
+{
+	Serial.print("From ");
+	Serial.print((uint8_t)msg->ID, HEX);
+	Serial.print(": ");
+	Serial.println(msg->buffer);
+}
+
+void setup()
+{
+	Serial.begin(9600);
+	while (!Serial)
+		;
+
+	brcClient.begin(9600);
+	brcClient.beginBRCClient(AP_SSID, AP_PASSWD, TCP_IP, TCP_PORT);
+	brcClient.beginReceiveQueue(&rxQueue);
+
+	brcClient.onRoundStart(printRoundStart);
+	brcClient.onRoundEnd(printRoundEnd);
+	brcClient.onMapData(printMapData);
+	brcClient.onCustom(printCustom);
+	brcClient.onBroadcast(printCustom);
+
+	delay(2000);
+	if (brcClient.registerID(MY_COMM_ID))
+		Serial.println("ID register OK");
+	else {
+		Serial.println("ID register FAIL");
+		brcClient.endBRCClient();
+
+		while (1)
+			;
+	}
+}
+
+void loop()
+{
+	// The messages received while registering are dispatched here as well.
+	brcClient.dispatchMessages();
+}
@@ -0,0 +1,88 @@
+/* Download the whole map before the round starts,
+ * and print it as a grid.
+ */
+
+#include <BRCClient.h>
+
+/* If you are using UNO, uncomment the next line. */
+// #define UNO
+/* If you are using MEGA and want to use HardwareSerial,
+ * umcomment the next 2 lines. */
+// #define USE_HARDWARE_SERIAL
+// #define HW_SERIAL Serial3
+
+#ifdef UNO
+ #define UART_RX 3
+ #define UART_TX 2
+#else
+ #define UART_RX 10
+ #define UART_TX 2
+#endif
+
+#if !defined(UNO) && defined(USE_HARDWARE_SERIAL)
+ BRCClient brcClient(&HW_SERIAL);
+#else
+ BRCClient brcClient(UART_RX, UART_TX);
+#endif
+
+// You have to modify the corresponding parameter
+#define AP_SSID    "AP_SSID"
+#define AP_PASSWD  "AP_PASSWD"
+#define TCP_IP     "TCP_IP"
+#define TCP_PORT   5000
+#define MY_COMM_ID (char)0x24
+
+void printRoundStart(const CommMsg *msg)
+{
+	Serial.println("Round start");
+}
+
+MapStore mapStore;
+// Keep the messages received while downloading the map.
+MsgQueue<2> rxQueue;
+
+void setup()
+{
+	Serial.begin(9600);
+	while (!Serial)
+		;
+
+	brcClient.begin(9600);
+	brcClient.beginBRCClient(AP_SSID, AP_PASSWD, TCP_IP, TCP_PORT);
+	brcClient.beginReceiveQueue(&rxQueue);
+	brcClient.onRoundStart(printRoundStart);
+
+	delay(2000);
+	// The map is only sent in the wire protocol v2.
+	if (!brcClient.beginProtocolV2() || !brcClient.registerID(MY_COMM_ID)) {
+		Serial.println("Setup FAIL");
+		brcClient.endBRCClient();
+
+		while (1)
+			;
+	}
+
+	if (!brcClient.downloadMap(&mapStore))
+		Serial.println("Map download FAIL");
+
+	// '.' for a normal block, 'T' for a treasure, 'P' for a park, ' ' for no block.
+	for (int8_t y = 0; y < MAP_GRID_H; ++y) {
+		for (int8_t x = 0; x < MAP_GRID_W; ++x) {
+			switch (mapStore.typeAt(x, y)) {
+				case MAP_NORMAL:   Serial.print('.'); break;
+				case MAP_TREASURE: Serial.print('T'); break;
+				case MAP_INVAILD:  Serial.print(' '); break;
+				default:           Serial.print('P'); break;
+			}
+		}
+		Serial.println();
+	}
+	Serial.print(mapStore.size());
+	Serial.println(" blocks");
+}
+
+void loop()
+{
+	// The blocks are found by the serial number with MapStore::find().
+	brcClient.dispatchMessages();
+}
@@ -4,6 +4,7 @@
 #include <BRCClient.h>
 #include <SPI.h>
 #include <RFID.h>
+#include <TagScanner.h>
 
 /* If you are using UNO, uncomment the next line. */
 // #define UNO
@@ -38,6 +39,10 @@
 #define MFRC522_RSTPD 9
 
 RFID rfid(SPI_SS, MFRC522_RSTPD);
+// Report each tag once when it comes, instead of every time it's read.
+TagScanner scanner(&rfid);
+// Keep the map data received, so a tag is only requested once.
+MapCache<8> mapCache;
 
 void setup()
 {
@@ -52,6 +57,7 @@ void setup()
 
 	brcClient.begin(9600);
 	brcClient.beginBRCClient(AP_SSID, AP_PASSWD, TCP_IP, TCP_PORT);
+	brcClient.beginMapCache(&mapCache);
 
 	delay(2000);
 	if (brcClient.registerID(MY_COMM_ID))
@@ -60,17 +66,22 @@ void setup()
 		Serial.println("ID register FAIL");
 }
 
-// The length of serial number of the tag we use here is 4 bytes.
-static uint8_t tagSN[4];
-
 void loop()
 {
 	CommMsg msg;
+	MapMsg map;
+	TagEvent tag;
 	char buf[40];
 
-	// If it read a serial number, reqeust the map data from server.
-	if (readTagSN()) {
-		brcClient.requestMapData(tagSN);
+	// If a tag comes, look it up in the map cache,
+	// or reqeust the map data from server.
+	// The length of serial number of the tag we use here is 4 bytes.
+	if (scanner.poll(&tag) && tag.type == TAG_ENTER &&
+	    brcClient.findMapData(tag.sn, &map)) {
+		sprintf(buf, "CACHED: %02X%02X%02X%02X, (%02d, %02d), 0x%02X",
+				map.sn[0], map.sn[1], map.sn[2], map.sn[3],
+				map.x, map.y, map.type);
+		Serial.println(buf);
 	}
 
 	if (brcClient.receiveMessage(&msg)) {
@@ -79,7 +90,7 @@ void loop()
 
 		if (msg.type == MSG_REQUEST_RFID) {
 			// Use this function to convert the raw data to the map data.
-			MapMsg map = rawDataToMapMsg(msg.buffer);
+			map = rawDataToMapMsg(msg.buffer);
 
 			// Display the converted data.
 			sprintf(buf, "MAP: %02X%02X%02X%02X, (%02d, %02d), 0x%02X",
@@ -95,40 +106,4 @@ void loop()
 		while (1)
 			;
 	}
-
-	delay(200);
-}
-
-/**
- * @brief Read the serial number of the RFID tag.
- *
- * This function will save the 4-byte serial number to the global variable _tagSN_.
- * Therefore, you can directly call the function _BRCClient::requestMapData()_ without
- * extracting first 4 bytes from _sn_.
- * Futhermore, you can check if the serial number read has been already known in
- * the function. For example, return false if the serial number has been already
- * known to avoid the program reqeusting the same data from the server.
- */
-bool readTagSN()
-{
-	uint8_t status, snBytes, sn[MAXRLEN];
-	uint16_t card_type;
-
-	if ((status = rfid.findTag(&card_type)) == STATUS_OK &&
-	    card_type == 1024) {
-		if ((status = rfid.readTagSN(sn, &snBytes)) == STATUS_OK) {
-			// Loop unrolling
-			// The length of serial number of the tag we use here is 4 bytes.
-			tagSN[0] = sn[0];
-			tagSN[1] = sn[1];
-			tagSN[2] = sn[2];
-			tagSN[3] = sn[3];
-
-			rfid.piccHalt();
-
-			return true;
-		}
-	}
-
-	return false;
 }
@@ -0,0 +1,10 @@
+/* Generated by MapImageGen from arena.txt: 4 blocks, version 0x4ED3 */
+#include <MapImage.h>
+
+const uint8_t ARENA_MAP[] PROGMEM = {
+	MAP_IMAGE_MAGIC_0, MAP_IMAGE_MAGIC_1, 0x4E, 0xD3, 0x00, 0x04,
+	0xB0, 0xC0, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0xB0, 0xC0, 0x01, 0x02, 0x01, 0x02, 0x01,
+	0xB0, 0xC0, 0x02, 0x01, 0x02, 0x01, 0x02,
+	0xB0, 0xC0, 0x02, 0x02, 0x02, 0x02, 0x21,
+};
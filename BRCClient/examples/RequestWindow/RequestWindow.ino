@@ -0,0 +1,94 @@
+/* Stream the custom messages to the partner without waiting
+ * for each ack, and print the result of each message.
+ */
+
+#include <BRCClient.h>
+
+/* If you are using UNO, uncomment the next line. */
+// #define UNO
+/* If you are using MEGA and want to use HardwareSerial,
+ * umcomment the next 2 lines. */
+// #define USE_HARDWARE_SERIAL
+// #define HW_SERIAL Serial3
+
+#ifdef UNO
+ #define UART_RX 3
+ #define UART_TX 2
+#else
+ #define UART_RX 10
+ #define UART_TX 2
+#endif
+
+#if !defined(UNO) && defined(USE_HARDWARE_SERIAL)
+ BRCClient brcClient(&HW_SERIAL);
+#else
+ BRCClient brcClient(UART_RX, UART_TX);
+#endif
+
+// You have to modify the corresponding parameter
+#define AP_SSID    "AP_SSID"
+#define AP_PASSWD  "AP_PASSWD"
+#define TCP_IP     "TCP_IP"
+#define TCP_PORT   5000
+#define MY_COMM_ID (char)0x24
+
+#define PARTNER_COMM_ID (char)0x20
+
+unsigned int count = 0;
+
+void printAck(uint8_t seq, int8_t status)
+{
+	Serial.print("Message ");
+	Serial.print(seq);
+	if (status == ACK_OK)
+		Serial.println(" OK");
+	else if (status == ACK_FAIL)
+		Serial.println(" FAIL");
+	else
+		Serial.println(" TIMEOUT");
+}
+
+void setup()
+{
+	Serial.begin(9600);
+	while (!Serial)
+		;
+
+	brcClient.begin(9600);
+	brcClient.beginBRCClient(AP_SSID, AP_PASSWD, TCP_IP, TCP_PORT);
+
+	// The acks are matched by the sequence number in v2.
+	brcClient.beginProtocolV2();
+
+	delay(2000);
+	if (brcClient.registerID(MY_COMM_ID))
+		Serial.println("ID register OK");
+	else {
+		Serial.println("ID register FAIL");
+		brcClient.endBRCClient();
+
+		while (1)
+			;
+	}
+
+	brcClient.onAck(printAck);
+}
+
+void loop()
+{
+	CommMsg msg;
+
+	// Send as long as the window has room.
+	if (brcClient.inFlight() < ACK_WINDOW) {
+		msg.type = MSG_CUSTOM;
+		msg.ID = PARTNER_COMM_ID;
+		sprintf(msg.buffer, "Hello %u", count++);
+		brcClient.sendRequest(&msg);
+	}
+
+	// Match the acks and print the other messages.
+	if (brcClient.receiveMessage(&msg)) {
+		Serial.print("Received: ");
+		Serial.println(msg.buffer);
+	}
+}
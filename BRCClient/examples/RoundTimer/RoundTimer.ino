@@ -2,7 +2,7 @@
  * Stop the timer when receive the MSG_ROUND_END.
  *
  * If the program reveived a 'e' from Serial,
- * send MSG_ROUND_COMPELETE to the BRC server.
+ * send MSG_ROUND_COMPLETE to the BRC server by complete().
  * If the program received a 'q' from Serial.
  * quit from the BRC server and go into a infinite loop.
  */
@@ -47,7 +47,8 @@ void setup()
 	brcClient.beginBRCClient(AP_SSID, AP_PASSWD, TCP_IP, TCP_PORT);
 
 	delay(2000);
-	if (brcClient.registerID(MY_COMM_ID))
+	// The clock is only synchronized in the wire protocol v2.
+	if (brcClient.beginProtocolV2() && brcClient.registerID(MY_COMM_ID))
 		Serial.println("ID register OK");
 	else {
 		Serial.println("ID register FAIL");
@@ -57,39 +58,51 @@ void setup()
 			;
 	}
 
+	// Estimate the clock of the server, so the round starts and ends
+	// at the time of the server instead of when the messages are read.
+	if (brcClient.syncClock())
+		Serial.println("Clock sync OK");
+
 	// Wait for 5 seconds.
 	delay(5000);
 }
 
-static long startFromMillis = 0L;
-static long lastSecondMillis = 0L;
-static bool timing = false;
+static unsigned long lastSecondMillis = 0L;
+
+void printTime(unsigned long ms)
+{
+	Serial.print(ms / 1000L);
+	Serial.print(".");
+	Serial.print(ms % 1000L / 100L);
+	Serial.println(" sec.");
+}
 
 void loop()
 {
 	CommMsg msg;
+	const RoundMetrics &metrics = brcClient.roundMetrics();
 
-	if (timing && (millis() - lastSecondMillis) > 1000L) {
+	// BRCClient tracks the round by MSG_ROUND_START and MSG_ROUND_END.
+	if (brcClient.roundState() == ROUND_STARTED &&
+	    (millis() - lastSecondMillis) > 1000L) {
 		lastSecondMillis = millis();
-		Serial.print((lastSecondMillis - startFromMillis) / 1000L);
+		Serial.print((lastSecondMillis - metrics.startTime) / 1000L);
 		Serial.println(" sec.");
 	}
 
 	if (brcClient.receiveMessage(&msg)) {
 		switch (msg.type) {
 			case MSG_ROUND_START:
-				startFromMillis = millis();
-				lastSecondMillis = startFromMillis;
-				timing = true;
+				lastSecondMillis = metrics.startTime;
 				Serial.println("0 sec.");
 				break;
 
 			case MSG_ROUND_END:
-				timing = false;
-				Serial.print((millis() - startFromMillis) / 1000L);
-				Serial.print(".");
-				Serial.print(((millis() - startFromMillis) % 1000L / 100L));
-				Serial.println(" sec.");
+				printTime(metrics.endTime);
+				if (metrics.completed) {
+					Serial.print("Completed at ");
+					printTime(metrics.completeTime);
+				}
 				break;
 		}
 	}
@@ -97,8 +110,9 @@ void loop()
 	if (Serial.available()) {
 		char ch = Serial.read();
 		if (ch == 'e') {
-			msg.type = MSG_ROUND_COMPELETE;
-			brcClient.sendMessage(&msg);
+			// It's only sent once in a round.
+			if (!brcClient.complete())
+				Serial.println("Not in a round");
 		} else if (ch == 'q') {
 			brcClient.endBRCClient();
 			while (1)
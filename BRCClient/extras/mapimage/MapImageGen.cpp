@@ -0,0 +1,117 @@
+/*
+ * Generate the map image in PROGMEM for BRCClient::beginMapImage().
+ *
+ * Usage: MapImageGen [-n name] [-d | mapFile] > MapImageData.h
+ *
+ *   -n  The name of the array. Default "MAP_IMAGE".
+ *   -d  The default map of BRCServer: a 10 x 10 grid of MAP_NORMAL, sn = {0xB0, 0xC0, x, y}.
+ *
+ * The map file is the same as BRCServer -m: one block per line,
+ * "<sn in 8 hex digits> <x> <y> <type in hex>".
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <map>
+
+#include "CommMsg.h"
+#include "MapMsg.h"
+
+static std::map<uint32_t, MapMsg> blocks;	// By sn, big-endian
+
+static void addBlock(uint32_t sn, int x, int y, char type)
+{
+	MapMsg block;
+
+	block.sn[0] = sn >> 24;
+	block.sn[1] = sn >> 16;
+	block.sn[2] = sn >> 8;
+	block.sn[3] = sn;
+	block.x = x;
+	block.y = y;
+	block.type = type;
+	blocks[sn] = block;
+}
+
+static bool loadMap(const char *path)
+{
+	FILE *fp = fopen(path, "r");
+	unsigned int sn, type;
+	int x, y;
+
+	if (fp == NULL)
+		return false;
+	while (fscanf(fp, "%x %d %d %x", &sn, &x, &y, &type) == 4)
+		addBlock(sn, x, y, (char)type);
+	fclose(fp);
+
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	std::map<uint32_t, MapMsg>::const_iterator it;
+	const char *name = "MAP_IMAGE", *source = NULL;
+	bool defaultMap = false;
+	uint16_t version = 0xFFFF;
+	char block[MAP_BLOCK_LEN];
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:d")) != -1) {
+		switch (opt) {
+			case 'n': name = optarg; break;
+			case 'd': defaultMap = true; break;
+			default:
+				fprintf(stderr, "Usage: %s [-n name] [-d | mapFile]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if (defaultMap) {
+		source = "the default map of BRCServer";
+		for (int x = 0; x < 10; ++x) {
+			for (int y = 0; y < 10; ++y)
+				addBlock(0xB0C00000u | x << 8 | y, x, y, MAP_NORMAL);
+		}
+	} else if (optind < argc) {
+		source = argv[optind];
+		if (!loadMap(source)) {
+			perror(source);
+			return 1;
+		}
+	} else {
+		fprintf(stderr, "No map\n");
+		return 1;
+	}
+
+	if (blocks.size() > 0xFFFF) {
+		fprintf(stderr, "Too many blocks\n");
+		return 1;
+	}
+
+	for (it = blocks.begin(); it != blocks.end(); ++it) {
+		memcpy(block, it->second.sn, 4);
+		block[4] = it->second.x;
+		block[5] = it->second.y;
+		block[6] = it->second.type;
+		version = mapVersion(version, block);
+	}
+
+	printf("/* Generated by MapImageGen from %s: %zu blocks, version 0x%04X */\n",
+	       source, blocks.size(), version);
+	printf("#include <MapImage.h>\n\n");
+	printf("const uint8_t %s[] PROGMEM = {\n", name);
+	printf("\tMAP_IMAGE_MAGIC_0, MAP_IMAGE_MAGIC_1, 0x%02X, 0x%02X, 0x%02X, 0x%02X,\n",
+	       version >> 8, version & 0xFF, (unsigned)blocks.size() >> 8, (unsigned)blocks.size() & 0xFF);
+	for (it = blocks.begin(); it != blocks.end(); ++it) {
+		printf("\t0x%02X, 0x%02X, 0x%02X, 0x%02X, 0x%02X, 0x%02X, 0x%02X,\n",
+		       it->second.sn[0], it->second.sn[1], it->second.sn[2], it->second.sn[3],
+		       (uint8_t)it->second.x, (uint8_t)it->second.y, (uint8_t)it->second.type);
+	}
+	printf("};\n");
+
+	return 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * The load generator of the BRC server. It runs many BRCClient on the emulated modules,
+ * one thread for each, and measures the delivery latency of the messages.
+ *
+ * Usage: BRCLoad [-n clients] [-p port] [-d seconds] [-i intervalMs] [-m mode] [-b baudrate] [-2] [-w]
+ *
+ *   -n  The number of clients, at most 239 (ID 0x10 to 0xFE). Default 100.
+ *   -p  The port of the server on 127.0.0.1. Default 5000.
+ *   -d  The duration of the load in seconds. Default 10.
+ *   -i  The interval of sending of each client in milliseconds. Default 1000.
+ *   -m  "broadcast": MSG_CUSTOM_BROADCAST, the latency is measured at each receiver.
+ *       "unicast": MSG_CUSTOM to a random client, the latency is measured at the receiver.
+ *       "map": MSG_REQUEST_RFID, the latency is the round trip. Default "broadcast".
+ *   -b  The baudrate of the emulated UART, 0 for no pacing. Default 115200.
+ *   -2  Use the wire protocol v2.
+ *   -w  Send by the request window (BRCClient::sendRequest()) instead of BRCClient::sendMessage().
+ */
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "BRCClient.h"
+#include "ESP8266Emulator.h"
+
+#define FIRST_ID 0x10
+#define MAX_CLIENTS (0xFF - FIRST_ID)
+
+enum { MODE_BROADCAST, MODE_UNICAST, MODE_MAP };
+
+static int port = 5000;
+static int clientCount = 100;
+static unsigned long duration = 10;
+static unsigned long interval = 1000;
+static int mode = MODE_BROADCAST;
+static unsigned long baudrate = 115200;
+static bool protocolV2 = false;
+static bool window = false;
+
+static std::atomic<int> ready(0), failed(0);
+static std::atomic<unsigned long> sent(0), acked(0), sendFailed(0), ackFailed(0);
+static std::mutex resultLock;
+static std::vector<unsigned long> latencies;	// In microseconds
+
+static void countAck(uint8_t, int8_t status)
+{
+	if (status == ACK_OK)
+		++acked;
+	else
+		++ackFailed;
+}
+
+static void runClient(int index)
+{
+	ESP8266Emulator emu;
+	BRCClient client(&emu);
+	std::vector<unsigned long> local;
+	unsigned int seed = index + 1;
+	unsigned long end, next, ts, start = 0;
+	bool waitMap = false;
+	CommMsg msg;
+	uint8_t sn[4];
+
+	emu.addAP("BRC", "12345678");
+	client.setAutoRecover(false);
+	client.onAck(countAck);
+	if (!client.begin(baudrate) ||
+	    !client.beginBRCClient("BRC", "12345678", "127.0.0.1", port) ||
+	    (protocolV2 && !client.beginProtocolV2()) ||
+	    !client.registerID(FIRST_ID + index)) {
+		++failed;
+		++ready;
+		return;
+	}
+
+	// Start together
+	++ready;
+	while (ready < clientCount)
+		usleep(1000);
+
+	end = millis() + duration * 1000;
+	next = millis() + rand_r(&seed) % interval;
+	while (millis() < end) {
+		if (millis() >= next && !waitMap) {
+			next += interval;
+			memset(&msg, 0, sizeof(msg));
+			sprintf(msg.buffer, "T%lu", micros());
+			switch (mode) {
+				case MODE_BROADCAST:
+					msg.type = MSG_CUSTOM_BROADCAST;
+					break;
+				case MODE_UNICAST:
+					msg.type = MSG_CUSTOM;
+					msg.ID = FIRST_ID + rand_r(&seed) % clientCount;
+					break;
+				case MODE_MAP:
+					sn[0] = 0xB0;
+					sn[1] = 0xC0;
+					sn[2] = rand_r(&seed) % 10 + 1;	// Avoid null characters in sn
+					sn[3] = rand_r(&seed) % 10 + 1;
+					msg.type = MSG_REQUEST_RFID;
+					memcpy(msg.buffer, sn, 4);
+					msg.buffer[4] = '\0';
+					waitMap = true;
+					start = micros();
+					break;
+			}
+			if (window && mode != MODE_MAP ? client.sendRequest(&msg) >= 0 : client.sendMessage(&msg))
+				++sent;
+			else
+				++sendFailed;
+		}
+
+		if (!client.receiveMessage(&msg)) {
+			usleep(200);
+			continue;
+		}
+
+		switch (msg.type) {
+			case MSG_CUSTOM:
+			case MSG_CUSTOM_BROADCAST:
+				if (strcmp(msg.buffer, "OK") == 0)
+					acked += !window;	// Late acks of the window are counted by countAck()
+				else if (sscanf(msg.buffer, "T%lu", &ts) == 1)
+					local.push_back(micros() - ts);
+				break;
+			case MSG_REQUEST_RFID:
+				if (waitMap) {
+					local.push_back(micros() - start);
+					waitMap = false;
+				}
+				break;
+		}
+	}
+
+	client.endBRCClient();
+
+	std::lock_guard<std::mutex> lock(resultLock);
+	latencies.insert(latencies.end(), local.begin(), local.end());
+}
+
+static unsigned long percentile(double p)
+{
+	return latencies[(size_t)(p * (latencies.size() - 1))];
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::thread> threads;
+	unsigned long long sum = 0;
+	unsigned long start;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:p:d:i:m:b:2w")) != -1) {
+		switch (opt) {
+			case 'n': clientCount = std::min(atoi(optarg), MAX_CLIENTS); break;
+			case 'p': port = atoi(optarg); break;
+			case 'd': duration = strtoul(optarg, NULL, 10); break;
+			case 'i': interval = std::max(strtoul(optarg, NULL, 10), 1UL); break;
+			case 'm':
+				mode = strcmp(optarg, "unicast") == 0 ? MODE_UNICAST :
+				       strcmp(optarg, "map") == 0 ? MODE_MAP : MODE_BROADCAST;
+				break;
+			case 'b': baudrate = strtoul(optarg, NULL, 10); break;
+			case '2': protocolV2 = true; break;
+			case 'w': window = true; break;
+			default:
+				fprintf(stderr, "Usage: %s [-n clients] [-p port] [-d seconds] [-i intervalMs] "
+				                "[-m broadcast|unicast|map] [-b baudrate] [-2] [-w]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	start = millis();	// Start the clock before the threads
+	for (int i = 0; i < clientCount; ++i)
+		threads.push_back(std::thread(runClient, i));
+	for (size_t i = 0; i < threads.size(); ++i)
+		threads[i].join();
+
+	std::sort(latencies.begin(), latencies.end());
+	for (size_t i = 0; i < latencies.size(); ++i)
+		sum += latencies[i];
+
+	printf("%d clients, %d failed to register, %lu s in total\n",
+	       clientCount, failed.load(), (millis() - start) / 1000);
+	printf("%lu sent, %lu send failed, %lu acked, %lu not acked, %zu delivered (%.1f per second)\n",
+	       sent.load(), sendFailed.load(), acked.load(), ackFailed.load(), latencies.size(),
+	       (double)latencies.size() / duration);
+	if (!latencies.empty())
+		printf("latency us: min %lu, avg %llu, p50 %lu, p90 %lu, p99 %lu, max %lu\n",
+		       latencies.front(), sum / latencies.size(), percentile(0.5), percentile(0.9),
+		       percentile(0.99), latencies.back());
+
+	return failed == 0 ? 0 : 2;
+}
@@ -0,0 +1,720 @@
+/*
+ * A stand-in BRC server on the host, for developing and load testing BRCClient.
+ *
+ * Usage: BRCServer [-p port] [-m mapFile] [-r roundMs] [-q]
+ *
+ *   -p  The TCP and UDP port. Default 5000.
+ *   -m  The map: one block per line, "<sn in 8 hex digits> <x> <y> <type in hex>".
+ *       Default is a 10 x 10 grid of MAP_NORMAL, sn = {0xB0, 0xC0, x, y}.
+ *   -r  Start a round when the first client registers, and end it after roundMs.
+ *   -q  Don't print the messages.
+ *
+ * Commands from stdin: "start", "end", "stats".
+ *
+ * MSG_TIME_SYNC, MSG_ROUND_START, and MSG_ROUND_END carry the time of the server since its start, in v2.
+ * MSG_MAP_VERSION is answered with the version of the map image made by MapImageGen (MapImage.h).
+ * MSG_MAP_DUMP is answered in pages of the frames requested by BRCClient::downloadMap().
+ *
+ * The messages on TCP are the CommMsg encoded by BRCClient::encodeMessage().
+ * In v1, a read containing null characters is split into several messages, as the module may
+ * pass several sends in one read.
+ * MSG_REQUEST_RFID, MSG_ROUND_COMPLETE, and MSG_TIME_SYNC are taken by their fixed length in v1.
+ * A client switches to the v2 frames by MSG_PROTOCOL (BRCClient::beginProtocolV2()).
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "CommMsg.h"
+#include "MapMsg.h"
+
+#define DEFAULT_PORT 5000
+#define NO_ID 0xFF
+
+struct Client {
+	int fd;
+	uint8_t id;		///< NO_ID before registered
+	std::string name;	///< "ip:port" for the log
+	uint8_t protocol;	///< PROTOCOL_V1 or PROTOCOL_V2
+	uint8_t txSeq;		///< The sequence number of the next v2 frame
+	std::string rx;		///< The received bytes of the incomplete v2 frame
+};
+
+struct UdpPeer {
+	struct sockaddr_in addr;
+	uint8_t txSeq;
+};
+
+struct Block {
+	int8_t x;
+	int8_t y;
+	char type;
+};
+
+static std::vector<Client> clients;
+static std::map<uint8_t, UdpPeer> udpPeers;	// By client ID
+static std::map<uint32_t, Block> blocks;	// By sn, big-endian
+static int udpFd = -1;
+static bool quiet = false;
+static bool stdinOpen = true;
+
+static bool inRound = false;
+static unsigned long long roundStart;
+static unsigned long long serverStart;	// The time of the server counts from it
+static unsigned long roundLength = 0;
+
+static unsigned long long msgIn, msgOut, fanOut, telemetry, badFrames;
+
+static unsigned long long nowMs()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Get the time of the server in the messages: milliseconds since the start.
+ */
+static uint32_t serverTime()
+{
+	return (uint32_t)(nowMs() - serverStart);
+}
+
+static void putTime(char *buf, uint32_t time)
+{
+	buf[0] = (char)(time >> 24);
+	buf[1] = (char)(time >> 16);
+	buf[2] = (char)(time >> 8);
+	buf[3] = (char)time;
+}
+
+static uint32_t getTime(const char *buf)
+{
+	return (uint32_t)(uint8_t)buf[0] << 24 | (uint32_t)(uint8_t)buf[1] << 16 |
+	       (uint32_t)(uint8_t)buf[2] << 8 | (uint8_t)buf[3];
+}
+
+static void logf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static void logf(const char *fmt, ...)
+{
+	va_list args;
+
+	if (quiet)
+		return;
+	va_start(args, fmt);
+	vprintf(fmt, args);
+	va_end(args);
+	putchar('\n');
+	fflush(stdout);
+}
+
+static uint32_t snKey(const uint8_t *sn)
+{
+	return (uint32_t)sn[0] << 24 | (uint32_t)sn[1] << 16 | (uint32_t)sn[2] << 8 | sn[3];
+}
+
+/**
+ * @brief Write the block as [sn: 4 bytes][x][y][type].
+ */
+static void blockBytes(std::map<uint32_t, Block>::const_iterator it, char *block)
+{
+	block[0] = (char)(it->first >> 24);
+	block[1] = (char)(it->first >> 16);
+	block[2] = (char)(it->first >> 8);
+	block[3] = (char)it->first;
+	block[4] = it->second.x;
+	block[5] = it->second.y;
+	block[6] = it->second.type;
+}
+
+static bool loadMap(const char *path)
+{
+	FILE *fp = fopen(path, "r");
+	unsigned int sn, type;
+	int x, y;
+	Block block;
+
+	if (fp == NULL)
+		return false;
+	while (fscanf(fp, "%x %d %d %x", &sn, &x, &y, &type) == 4) {
+		block.x = x;
+		block.y = y;
+		block.type = (char)type;
+		blocks[sn] = block;
+	}
+	fclose(fp);
+
+	return true;
+}
+
+static void defaultMap()
+{
+	Block block;
+
+	for (int x = 0; x < 10; ++x) {
+		for (int y = 0; y < 10; ++y) {
+			block.x = x;
+			block.y = y;
+			block.type = MAP_NORMAL;
+			blocks[0xB0C00000u | x << 8 | y] = block;
+		}
+	}
+}
+
+static Client *findClient(uint8_t id)
+{
+	for (size_t i = 0; i < clients.size(); ++i) {
+		if (clients[i].id == id)
+			return &clients[i];
+	}
+	return NULL;
+}
+
+static void sendTo(Client &client, const char *data, size_t len)
+{
+	if (send(client.fd, data, len, MSG_NOSIGNAL) == (ssize_t)len)
+		++msgOut;
+}
+
+/**
+ * @brief Send a message in the wire protocol of the client.
+ * @param seq In v2, the sequence number of the request if it's the reply, otherwise -1.
+ */
+static void sendMessage(Client &client, char type, uint8_t id, const char *payload, size_t len,
+                        int seq = -1)
+{
+	char buf[FRAME_MAX_LEN];
+	uint16_t crc;
+
+	if (len > COMM_MSG_BUF_LEN - 1)
+		len = COMM_MSG_BUF_LEN - 1;
+
+	if (client.protocol == PROTOCOL_V2) {
+		buf[0] = FRAME_MAGIC;
+		buf[1] = type;
+		buf[2] = (char)id;
+		buf[3] = (char)(seq >= 0 ? seq : client.txSeq++);
+		buf[4] = (char)len;
+		memcpy(buf + FRAME_HEADER_LEN, payload, len);
+		crc = frameCRC(buf + 1, FRAME_HEADER_LEN - 1 + len);
+		buf[FRAME_HEADER_LEN + len] = (char)(crc >> 8);
+		buf[FRAME_HEADER_LEN + len + 1] = (char)(crc & 0xFF);
+		sendTo(client, buf, FRAME_HEADER_LEN + len + FRAME_CRC_LEN);
+	} else if (type == MSG_REQUEST_RFID) {
+		// The map data has no ID in v1.
+		buf[0] = type;
+		memcpy(buf + 1, payload, len);
+		sendTo(client, buf, len + 1);
+	} else {
+		buf[0] = type;
+		buf[1] = (char)id;
+		memcpy(buf + 2, payload, len);
+		sendTo(client, buf, len + 2);
+	}
+}
+
+static void sendReply(Client &client, char type, uint8_t id, const char *text, int seq = -1)
+{
+	sendMessage(client, type, id, text, strlen(text), seq);
+}
+
+static void startRound()
+{
+	char time[TIME_LEN];
+
+	inRound = true;
+	roundStart = nowMs();
+	putTime(time, serverTime());
+	for (size_t i = 0; i < clients.size(); ++i) {
+		if (clients[i].id != NO_ID)
+			// The time can contain null characters, so it's only sent in v2.
+			sendMessage(clients[i], MSG_ROUND_START, clients[i].id, time,
+			            clients[i].protocol == PROTOCOL_V2 ? TIME_LEN : 0);
+	}
+	logf("Round started");
+}
+
+static void endRound()
+{
+	char time[TIME_LEN];
+
+	inRound = false;
+	putTime(time, serverTime());
+	for (size_t i = 0; i < clients.size(); ++i) {
+		if (clients[i].id != NO_ID)
+			// The time can contain null characters, so it's only sent in v2.
+			sendMessage(clients[i], MSG_ROUND_END, clients[i].id, time,
+			            clients[i].protocol == PROTOCOL_V2 ? TIME_LEN : 0);
+	}
+	logf("Round ended after %llu ms", nowMs() - roundStart);
+}
+
+/**
+ * @brief Handle a message from the client.
+ * @param id The ID in the message, or the ID of the client if the message has no ID in v1.
+ * @param seq The sequence number of the v2 frame, echoed in the reply. -1 in v1.
+ */
+static void handleMessage(Client &client, char type, uint8_t id, const char *payload, size_t len,
+                          int seq)
+{
+	char buf[8];
+	std::string text;
+	Client *target;
+	uint32_t received = serverTime();
+
+	++msgIn;
+	switch (type) {
+		case MSG_PROTOCOL:
+			if (id != PROTOCOL_V2) {
+				sendReply(client, MSG_PROTOCOL, id, "FAIL", seq);
+				break;
+			}
+			// The reply is still in v1.
+			sendReply(client, MSG_PROTOCOL, id, "OK", seq);
+			client.protocol = PROTOCOL_V2;
+			client.txSeq = 0;
+			logf("%s: protocol v2", client.name.c_str());
+			break;
+
+		case MSG_REGISTER:
+			target = findClient(id);
+			if (id < 0x10 || id == NO_ID || (target != NULL && target != &client)) {
+				sendReply(client, MSG_REGISTER, id, "FAIL", seq);
+				logf("%s: register 0x%02X failed", client.name.c_str(), id);
+				break;
+			}
+			client.id = id;
+			sendReply(client, MSG_REGISTER, id, "OK", seq);
+			logf("%s: registered 0x%02X", client.name.c_str(), id);
+			if (roundLength != 0 && !inRound)
+				startRound();
+			break;
+
+		case MSG_REQUEST_RFID: {
+			uint8_t sn[4] = {0, 0, 0, 0};
+			std::map<uint32_t, Block>::const_iterator it;
+
+			memcpy(sn, payload, len < 4 ? len : 4);
+			it = blocks.find(snKey(sn));
+			memcpy(buf, sn, 4);
+			buf[4] = it != blocks.end() ? it->second.x : -1;
+			buf[5] = it != blocks.end() ? it->second.y : -1;
+			buf[6] = it != blocks.end() ? it->second.type : MAP_INVAILD;
+			sendMessage(client, MSG_REQUEST_RFID, 0x01, buf, 7, seq);
+			logf("0x%02X: map %08X -> (%d, %d)", client.id, snKey(sn), buf[4], buf[5]);
+			break;
+		}
+
+		case MSG_MAP_DUMP: {
+			std::map<uint32_t, Block>::const_iterator it;
+			size_t total = blocks.size() < 0xFFFF ? blocks.size() : 0xFFFF;
+			size_t first = len > 1 ? (size_t)(uint8_t)payload[0] << 8 | (uint8_t)payload[1] : 0;
+			size_t frames = len > 2 ? (uint8_t)payload[2] : 1;
+			char page[COMM_MSG_BUF_LEN];
+			size_t n;
+
+			// The blocks contain null characters, which can't be sent in v1.
+			if (client.protocol != PROTOCOL_V2) {
+				logf("%s: map dump in v1", client.name.c_str());
+				break;
+			}
+
+			it = blocks.begin();
+			std::advance(it, first < total ? first : total);
+			do {
+				page[0] = (char)(total >> 8);
+				page[1] = (char)total;
+				page[2] = (char)(first >> 8);
+				page[3] = (char)first;
+				for (n = 0; n < MAP_DUMP_BLOCKS && first < total; ++n, ++first, ++it)
+					blockBytes(it, page + MAP_DUMP_HEADER_LEN + n * MAP_BLOCK_LEN);
+				sendMessage(client, MSG_MAP_DUMP, 0x01, page, MAP_DUMP_HEADER_LEN + n * MAP_BLOCK_LEN, seq);
+			} while (--frames > 0 && first < total);
+			logf("%s: map dump up to %zu of %zu", client.name.c_str(), first, total);
+			break;
+		}
+
+		case MSG_MAP_VERSION: {
+			std::map<uint32_t, Block>::const_iterator it;
+			uint16_t version = 0xFFFF;
+			char block[MAP_BLOCK_LEN];
+
+			// The same as the version of the map image made by MapImageGen
+			for (it = blocks.begin(); it != blocks.end(); ++it) {
+				blockBytes(it, block);
+				version = mapVersion(version, block);
+			}
+			buf[0] = (char)(version >> 8);
+			buf[1] = (char)version;
+			buf[2] = (char)(blocks.size() >> 8);
+			buf[3] = (char)blocks.size();
+			sendMessage(client, MSG_MAP_VERSION, 0x01, buf, 4, seq);
+			logf("%s: map version %04X", client.name.c_str(), version);
+			break;
+		}
+
+		case MSG_TIME_SYNC: {
+			char times[3 * TIME_LEN];
+
+			// [t0 of the client][t1: received][t2: replied]
+			memset(times, 0, TIME_LEN);
+			memcpy(times, payload, len < TIME_LEN ? len : TIME_LEN);
+			putTime(times + TIME_LEN, received);
+			putTime(times + 2 * TIME_LEN, serverTime());
+			sendMessage(client, MSG_TIME_SYNC, client.id, times, sizeof(times), seq);
+			break;
+		}
+
+		case MSG_ROUND_COMPLETE:
+			// The time reported by the client doesn't include the latency.
+			if (len >= TIME_LEN && getTime(payload) != 0)
+				logf("0x%02X: round complete in %lld ms (received after %llu ms)", client.id,
+				     inRound ? (long long)getTime(payload) - (long long)(roundStart - serverStart) : 0LL,
+				     inRound ? nowMs() - roundStart : 0ULL);
+			else
+				logf("0x%02X: round complete in %llu ms", client.id,
+				     inRound ? nowMs() - roundStart : 0ULL);
+			break;
+
+		case MSG_CUSTOM:
+			text.assign(payload, len);
+			target = findClient(id);
+			if (target != NULL && client.id != NO_ID) {
+				sendMessage(*target, MSG_CUSTOM, client.id, payload, len);
+				sendReply(client, MSG_CUSTOM, client.id, "OK", seq);
+				++fanOut;
+			} else {
+				sendReply(client, MSG_CUSTOM, client.id, "FAIL", seq);
+			}
+			logf("0x%02X -> 0x%02X: %s", client.id, id, text.c_str());
+			break;
+
+		case MSG_CUSTOM_BROADCAST:
+			text.assign(payload, len);
+			for (size_t i = 0; i < clients.size(); ++i) {
+				if (&clients[i] != &client && clients[i].id != NO_ID) {
+					sendMessage(clients[i], MSG_CUSTOM_BROADCAST, client.id, payload, len);
+					++fanOut;
+				}
+			}
+			sendReply(client, MSG_CUSTOM_BROADCAST, client.id, "OK", seq);
+			logf("0x%02X -> all: %s", client.id, text.c_str());
+			break;
+
+		default:
+			logf("%s: unknown type 0x%02X", client.name.c_str(), (uint8_t)type);
+			break;
+	}
+}
+
+/**
+ * @brief Handle the complete v2 frames in the receive buffer of the client.
+ */
+static void handleFrames(Client &client)
+{
+	std::string &rx = client.rx;
+	size_t len;
+	uint16_t crc;
+
+	while (!rx.empty()) {
+		if (rx[0] != FRAME_MAGIC) {	// Resynchronize
+			++badFrames;
+			rx.erase(0, 1);
+			continue;
+		}
+		if (rx.size() < FRAME_HEADER_LEN)
+			break;
+		len = (uint8_t)rx[4];
+		if (rx.size() < FRAME_HEADER_LEN + len + FRAME_CRC_LEN)
+			break;
+
+		crc = frameCRC(rx.data() + 1, FRAME_HEADER_LEN - 1 + len);
+		if ((uint8_t)rx[FRAME_HEADER_LEN + len] != (crc >> 8) ||
+		    (uint8_t)rx[FRAME_HEADER_LEN + len + 1] != (crc & 0xFF)) {
+			++badFrames;
+			rx.erase(0, 1);
+			continue;
+		}
+
+		handleMessage(client, rx[1], (uint8_t)rx[2], rx.data() + FRAME_HEADER_LEN, len, (uint8_t)rx[3]);
+		rx.erase(0, FRAME_HEADER_LEN + len + FRAME_CRC_LEN);
+	}
+}
+
+/**
+ * @brief Get the length of the payload of the v1 message types with a fixed length.
+ * @return -1 if the message ends at a null character.
+ */
+static int fixedLength(char type)
+{
+	switch (type) {
+		case MSG_REQUEST_RFID:   return 4;			// The binary sn
+		case MSG_ROUND_COMPLETE: return 0;			// No time in v1
+		case MSG_TIME_SYNC:      return TIME_LEN;	// The binary time, though the client only sends it in v2
+		default:                 return -1;
+	}
+}
+
+static void handleData(Client &client, const char *data, size_t len)
+{
+	size_t start = 0, end;
+	int fixed;
+	bool hasID;
+
+	// v1: The messages read together are separated by null characters.
+	// The types carrying binary data have a fixed length, so they are always taken as a whole.
+	while (start < len && client.protocol == PROTOCOL_V1) {
+		if (data[start] == '\0') {
+			++start;
+			continue;
+		}
+		end = start + 1;
+		if ((fixed = fixedLength(data[start])) >= 0)
+			end = start + 1 + fixed <= len ? start + 1 + fixed : len;
+		else
+			while (end < len && data[end] != '\0')
+				++end;
+
+		hasID = data[start] == MSG_REGISTER || data[start] == MSG_PROTOCOL || data[start] == MSG_CUSTOM;
+		if (hasID && end - start < 2)
+			++badFrames;
+		else if (hasID)
+			handleMessage(client, data[start], (uint8_t)data[start + 1],
+			              data + start + 2, end - start - 2, -1);
+		else
+			handleMessage(client, data[start], client.id, data + start + 1, end - start - 1, -1);
+		start = end;
+	}
+
+	// v2: The frames can be split over several reads.
+	if (start < len) {
+		client.rx.append(data + start, len - start);
+		handleFrames(client);
+	}
+}
+
+/**
+ * @brief Handle a datagram: [type][sequence number][message].
+ */
+static void handleDatagram(const char *data, size_t len, const struct sockaddr_in &from)
+{
+	char buf[COMM_MSG_BUF_LEN + 3];
+	uint8_t sender = NO_ID;
+	std::map<uint8_t, UdpPeer>::iterator it;
+
+	if (len < 2)
+		return;
+	++msgIn;
+
+	for (it = udpPeers.begin(); it != udpPeers.end(); ++it) {
+		if (it->second.addr.sin_addr.s_addr == from.sin_addr.s_addr &&
+		    it->second.addr.sin_port == from.sin_port)
+			sender = it->first;
+	}
+
+	switch (data[0]) {
+		case MSG_REGISTER:	// [type][seq][ID], sent when the client opens the channel
+			if (len < 3 || findClient((uint8_t)data[2]) == NULL)
+				break;
+			sender = (uint8_t)data[2];
+			// The client counts the sequence numbers from 0 again.
+			udpPeers[sender].txSeq = 0;
+			udpPeers[sender].addr = from;
+			logf("0x%02X: UDP channel opened", sender);
+			break;
+
+		case MSG_TELEMETRY:	// [type][seq][ID][data]
+			if (len < 3)
+				break;
+			sender = (uint8_t)data[2];
+			if (udpPeers.count(sender) == 0)
+				udpPeers[sender].txSeq = 0;
+			udpPeers[sender].addr = from;
+			++telemetry;
+			break;
+
+		case MSG_CUSTOM_BROADCAST:	// [type][seq][text]
+			if (len - 2 > COMM_MSG_BUF_LEN - 1)
+				break;
+			for (it = udpPeers.begin(); it != udpPeers.end(); ++it) {
+				if (it->first == sender)
+					continue;
+				buf[0] = MSG_CUSTOM_BROADCAST;
+				buf[1] = (char)it->second.txSeq++;
+				buf[2] = (char)sender;
+				memcpy(buf + 3, data + 2, len - 2);
+				if (sendto(udpFd, buf, len + 1, 0,
+				           (const struct sockaddr *)&it->second.addr, sizeof(it->second.addr)) > 0) {
+					++msgOut;
+					++fanOut;
+				}
+			}
+			break;
+	}
+}
+
+static int listenOn(int port, int type)
+{
+	struct sockaddr_in addr;
+	int fd = socket(AF_INET, type, 0), on = 1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    (type == SOCK_STREAM && listen(fd, 256) != 0)) {
+		perror("bind");
+		exit(1);
+	}
+
+	return fd;
+}
+
+static void printStats()
+{
+	size_t registered = 0;
+
+	for (size_t i = 0; i < clients.size(); ++i)
+		registered += clients[i].id != NO_ID;
+	printf("%zu clients, %zu registered, %llu in, %llu out, %llu forwarded, %llu telemetry, "
+	       "%llu bad frames\n",
+	       clients.size(), registered, msgIn, msgOut, fanOut, telemetry, badFrames);
+	fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+	int port = DEFAULT_PORT, tcpFd, opt, on = 1;
+	std::vector<struct pollfd> fds;
+	struct pollfd pfd;
+	struct sockaddr_in from;
+	socklen_t fromLen;
+	char buf[4096];
+	ssize_t n;
+
+	while ((opt = getopt(argc, argv, "p:m:r:q")) != -1) {
+		switch (opt) {
+			case 'p': port = atoi(optarg); break;
+			case 'm':
+				if (!loadMap(optarg)) {
+					perror(optarg);
+					return 1;
+				}
+				break;
+			case 'r': roundLength = strtoul(optarg, NULL, 10); break;
+			case 'q': quiet = true; break;
+			default:
+				fprintf(stderr, "Usage: %s [-p port] [-m mapFile] [-r roundMs] [-q]\n", argv[0]);
+				return 1;
+		}
+	}
+	if (blocks.empty())
+		defaultMap();
+	signal(SIGPIPE, SIG_IGN);
+	serverStart = nowMs() - 1;	// 0 is no time
+
+	tcpFd = listenOn(port, SOCK_STREAM);
+	udpFd = listenOn(port, SOCK_DGRAM);
+	printf("BRC server on port %d, %zu map blocks\n", port, blocks.size());
+	fflush(stdout);
+
+	for (;;) {
+		fds.clear();
+		pfd.events = POLLIN;
+		pfd.fd = tcpFd;
+		fds.push_back(pfd);
+		pfd.fd = udpFd;
+		fds.push_back(pfd);
+		pfd.fd = stdinOpen ? STDIN_FILENO : -1;
+		fds.push_back(pfd);
+		for (size_t i = 0; i < clients.size(); ++i) {
+			pfd.fd = clients[i].fd;
+			fds.push_back(pfd);
+		}
+
+		if (poll(&fds[0], fds.size(), 100) < 0 && errno != EINTR)
+			break;
+
+		if (inRound && roundLength != 0 && nowMs() - roundStart >= roundLength)
+			endRound();
+
+		if (fds[0].revents & POLLIN) {
+			Client client;
+
+			fromLen = sizeof(from);
+			client.fd = accept(tcpFd, (struct sockaddr *)&from, &fromLen);
+			if (client.fd >= 0) {
+				setsockopt(client.fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+				client.id = NO_ID;
+				client.protocol = PROTOCOL_V1;
+				client.txSeq = 0;
+				client.name = std::string(inet_ntoa(from.sin_addr)) + ":" +
+				              std::to_string(ntohs(from.sin_port));
+				clients.push_back(client);
+				logf("%s: connected", client.name.c_str());
+			}
+		}
+
+		if (fds[1].revents & POLLIN) {
+			fromLen = sizeof(from);
+			n = recvfrom(udpFd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &fromLen);
+			if (n > 0)
+				handleDatagram(buf, n, from);
+		}
+
+		if (fds[2].revents & POLLIN) {
+			if (fgets(buf, sizeof(buf), stdin) == NULL) {
+				stdinOpen = false;
+			} else if (strncmp(buf, "start", 5) == 0) {
+				startRound();
+			} else if (strncmp(buf, "end", 3) == 0) {
+				endRound();
+			} else if (strncmp(buf, "stats", 5) == 0) {
+				printStats();
+			}
+		}
+
+		// The clients accepted in this loop are not in fds.
+		for (size_t i = 3; i < fds.size(); ++i) {
+			Client &client = clients[i - 3];
+
+			if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+			n = recv(client.fd, buf, sizeof(buf), 0);
+			if (n > 0) {
+				handleData(client, buf, n);
+			} else {
+				logf("%s (0x%02X): closed", client.name.c_str(), client.id);
+				close(client.fd);
+				udpPeers.erase(client.id);
+				client.fd = -1;
+			}
+		}
+
+		for (size_t i = clients.size(); i-- > 0; ) {
+			if (clients[i].fd < 0)
+				clients.erase(clients.begin() + i);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,282 @@
+/**
+ * @file KSM111_ESP8266/CommandTrace.h
+ * @brief The instrumentation of KSM111_ESP8266T: the event trace and the latency statistics.
+ *
+ * The tracer is the template parameter <tt>Trace</tt> of KSM111_ESP8266T.
+ * NoTrace does nothing and costs nothing. CommandTrace records the events
+ * in a fixed ring and the latency of each operation. For example:
+ *
+ *     KSM111_ESP8266T<SoftSerialPort, 128, CommandTrace<16> > wifi(10, 11);
+ *     ...
+ *     wifi.trace().dump(Serial);
+ *
+ * To trace the class KSM111_ESP8266 and BRCClient, define KSM111_TRACE_EVENTS
+ * in this file.
+ */
+#ifndef _COMMAND_TRACE_H_
+#define _COMMAND_TRACE_H_
+
+#include <Arduino.h>
+#include <stdint.h>
+
+/**
+ * @brief The number of events kept by the tracer of class KSM111_ESP8266.
+ *
+ * 0 to disable the tracer. Each event takes 8 bytes.
+ */
+#ifndef KSM111_TRACE_EVENTS
+ #define KSM111_TRACE_EVENTS 0
+#endif
+
+/* Event type */
+#define TRACE_CMD_SENT   1	// value: The length of the command
+#define TRACE_FIRST_BYTE 2	// The first byte of the response arrived
+#define TRACE_TERMINAL   3	// arg: The status of the command, value: The length of the response
+#define TRACE_BYTES_TX   4	// arg: The link ID, value: The number of bytes sent by puts()
+#define TRACE_BYTES_RX   5	// arg: The link ID, value: The number of bytes received by gets()
+
+/* The operations measured */
+#define TRACE_OP_COMMAND 0	// From sending an AT command or data to the terminal response
+#define TRACE_OP_PUTS    1
+#define TRACE_OP_GETS    2	// Only the calls which return a message
+#define TRACE_OP_CONNECT 3	// beginClient()
+#define TRACE_OPS        4
+
+/* Latency histogram, bucket i counts the latency below 4^i milliseconds */
+#define TRACE_BUCKETS 8	// The last bucket counts the rest
+
+/**
+ * @struct TraceEvent KSM111_ESP8266/CommandTrace.h "CommandTrace.h"
+ * @brief A timestamped event.
+ */
+struct TraceEvent {
+	uint32_t time;	///< <tt>micros()</tt> when the event happened
+	uint8_t  type;	///< TRACE_CMD_SENT, TRACE_FIRST_BYTE...
+	int8_t   arg;
+	uint16_t value;
+};
+
+/**
+ * @struct LatencyStats KSM111_ESP8266/CommandTrace.h "CommandTrace.h"
+ * @brief The latency statistics of an operation in microseconds.
+ */
+struct LatencyStats {
+	uint16_t count;
+	uint32_t min;
+	uint32_t max;
+	uint32_t sum;	///< Wraps after about 71 minutes in total
+	uint16_t hist[TRACE_BUCKETS];
+
+	uint32_t avg() const { return count ? sum / count : 0; }
+};
+
+/**
+ * @class NoTrace KSM111_ESP8266/CommandTrace.h "CommandTrace.h"
+ * @brief The tracer which records nothing. All the calls are optimized out.
+ */
+class NoTrace
+{
+	public:
+		unsigned long now() const { return 0; }
+		void event(uint8_t, int8_t, uint16_t) {}
+		void commandSent(uint16_t) {}
+		void responseExpected() {}
+		void responseByte() {}
+		void commandDone(int8_t, uint16_t) {}
+		void record(uint8_t, unsigned long) {}
+};
+
+/**
+ * @class CommandTrace KSM111_ESP8266/CommandTrace.h "CommandTrace.h"
+ * @brief The tracer which keeps the latest <tt>EVENTS</tt> events and the latency of each operation.
+ * @tparam EVENTS The size of the event ring.
+ */
+template <uint8_t EVENTS>
+class CommandTrace
+{
+	public:
+		CommandTrace() { clear(); }
+
+		/**
+		 * @brief Drop all the events and the statistics.
+		 */
+		void clear()
+		{
+			memset(_events, 0, sizeof(_events));
+			memset(_stats, 0, sizeof(_stats));
+			_head = _count = 0;
+			_waitFirstByte = false;
+		}
+
+		/**
+		 * @brief The current timestamp for <tt>record()</tt>.
+		 */
+		unsigned long now() const { return micros(); }
+
+		/**
+		 * @brief Add an event. The oldest event is overwritten if the ring is full.
+		 */
+		void event(uint8_t type, int8_t arg, uint16_t value)
+		{
+			TraceEvent &e = _events[(_head + _count) % EVENTS];
+
+			e.time = micros();
+			e.type = type;
+			e.arg = arg;
+			e.value = value;
+			if (_count < EVENTS)
+				++_count;
+			else
+				_head = (_head + 1) % EVENTS;
+		}
+
+		/**
+		 * @name Hooks called by KSM111_ESP8266T
+		 */
+		/** @{ */
+		void commandSent(uint16_t len) { event(TRACE_CMD_SENT, 0, len); }
+
+		void responseExpected()
+		{
+			_cmdStart = micros();
+			_waitFirstByte = true;
+		}
+
+		void responseByte()
+		{
+			if (_waitFirstByte) {
+				_waitFirstByte = false;
+				event(TRACE_FIRST_BYTE, 0, 0);
+			}
+		}
+
+		void commandDone(int8_t status, uint16_t len)
+		{
+			_waitFirstByte = false;
+			event(TRACE_TERMINAL, status, len);
+			record(TRACE_OP_COMMAND, _cmdStart);
+		}
+
+		/**
+		 * @brief Add the latency of an operation.
+		 * @param op TRACE_OP_COMMAND, TRACE_OP_PUTS, TRACE_OP_GETS, or TRACE_OP_CONNECT.
+		 * @param start The value of <tt>now()</tt> when the operation started.
+		 */
+		void record(uint8_t op, unsigned long start)
+		{
+			LatencyStats &s = _stats[op];
+			uint32_t latency = micros() - start;
+			uint32_t bound = 1000;	// 1 ms
+			uint8_t i;
+
+			for (i = 0; i < TRACE_BUCKETS - 1 && latency >= bound; ++i)
+				bound <<= 2;
+			if (s.hist[i] < 0xFFFF)
+				++s.hist[i];
+
+			if (s.count == 0 || latency < s.min)
+				s.min = latency;
+			if (latency > s.max)
+				s.max = latency;
+			s.sum += latency;
+			++s.count;
+		}
+		/** @} */
+
+		/**
+		 * @brief Get the number of the events in the ring.
+		 */
+		uint8_t eventCount() const { return _count; }
+
+		/**
+		 * @brief Copy the events out of the ring, the oldest first.
+		 *
+		 * The events are kept. The copied bytes can be sent to the server as they are.
+		 *
+		 * @param events [out] The buffer for the events.
+		 * @param count [in] The max number of events to copy.
+		 * @return The number of events copied.
+		 */
+		uint8_t copyEvents(TraceEvent *events, uint8_t count) const
+		{
+			uint8_t i;
+
+			for (i = 0; i < count && i < _count; ++i)
+				events[i] = _events[(_head + i) % EVENTS];
+
+			return i;
+		}
+
+		/**
+		 * @brief Get the latency statistics of an operation.
+		 * @param op TRACE_OP_COMMAND, TRACE_OP_PUTS, TRACE_OP_GETS, or TRACE_OP_CONNECT.
+		 */
+		const LatencyStats &stats(uint8_t op) const { return _stats[op]; }
+
+		/**
+		 * @brief Print the events and the statistics in text.
+		 *
+		 * Event lines: "E <time> <type> <arg> <value>"<br />
+		 * Statistic lines: "L <op> <count> <min> <avg> <max> <bucket 0> ... <bucket 7>"
+		 *
+		 * @param out The output, for example, <tt>Serial</tt>.
+		 */
+		void dump(Print &out) const
+		{
+			uint8_t i, j;
+
+			for (i = 0; i < _count; ++i) {
+				const TraceEvent &e = _events[(_head + i) % EVENTS];
+
+				out.print("E ");
+				out.print((unsigned long)e.time);
+				out.print(' ');
+				out.print((unsigned int)e.type);
+				out.print(' ');
+				out.print((int)e.arg);
+				out.print(' ');
+				out.println((unsigned int)e.value);
+			}
+
+			for (i = 0; i < TRACE_OPS; ++i) {
+				const LatencyStats &s = _stats[i];
+
+				out.print("L ");
+				out.print((unsigned int)i);
+				out.print(' ');
+				out.print((unsigned int)s.count);
+				out.print(' ');
+				out.print((unsigned long)s.min);
+				out.print(' ');
+				out.print((unsigned long)s.avg());
+				out.print(' ');
+				out.print((unsigned long)s.max);
+				for (j = 0; j < TRACE_BUCKETS; ++j) {
+					out.print(' ');
+					out.print((unsigned int)s.hist[j]);
+				}
+				out.println();
+			}
+		}
+
+	private:
+		TraceEvent _events[EVENTS];
+		LatencyStats _stats[TRACE_OPS];
+
+		uint8_t _head;		///< The oldest event
+		uint8_t _count;		///< The number of events in the ring
+
+		unsigned long _cmdStart;	///< <tt>micros()</tt> when the response was expected
+		bool _waitFirstByte;		///< The first byte of the response hasn't arrived
+};
+
+/**
+ * @brief The tracer of class KSM111_ESP8266, selected by KSM111_TRACE_EVENTS.
+ */
+#if KSM111_TRACE_EVENTS > 0
+typedef CommandTrace<KSM111_TRACE_EVENTS> KSM111_DefaultTrace;
+#else
+typedef NoTrace KSM111_DefaultTrace;
+#endif
+
+#endif // _COMMAND_TRACE_H_
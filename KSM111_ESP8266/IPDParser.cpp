@@ -0,0 +1,229 @@
+#include <string.h>
+
+#include "IPDParser.h"
+
+/* The state of the parser */
+enum {
+	S_LINE_START,	// At the beginning of a line
+	S_LINE,			// In a line which is not a frame
+	S_PREFIX,		// Matching "+IPD,"
+	S_HEADER,		// Parsing "<id>,<len>:" or "<len>:"
+	S_DATA			// Receiving the data of the frame
+};
+
+static const char IPD_PREFIX[] = "+IPD,";
+#define IPD_PREFIX_LEN 5
+#define IPD_FRAME_HEADER_LEN 2
+
+void IPDParser::reset()
+{
+	for (uint8_t i = 0; i < IPD_MAX_LINKS; ++i) {
+		_rings[i].head = _rings[i].used = 0;
+		_rings[i].frames = 0;
+	}
+	_ring = NULL;
+	_state = S_LINE_START;
+	_dropped = _malformed = 0;
+}
+
+void IPDParser::putByte(uint8_t b)
+{
+	_ring->data[_write] = b;
+	_write = (_write + 1) % IPD_RING_SIZE;
+}
+
+uint8_t IPDParser::getByte(FrameRing *ring)
+{
+	uint8_t b = ring->data[ring->head];
+	ring->head = (ring->head + 1) % IPD_RING_SIZE;
+	return b;
+}
+
+void IPDParser::beginFrame()
+{
+	uint16_t frameLen = IPD_FRAME_HEADER_LEN + _remain;
+
+	_ring = (_link < IPD_MAX_LINKS) ? &_rings[_link] : NULL;
+	if (_ring == NULL || frameLen > IPD_RING_SIZE - _ring->used) {
+		_ring = NULL;
+		++_dropped;
+		return;
+	}
+
+	_write = (_ring->head + _ring->used) % IPD_RING_SIZE;
+	putByte((uint8_t)(_remain & 0xFF));
+	putByte((uint8_t)(_remain >> 8));
+	_number = frameLen;	// Keep the frame length for endFrame()
+}
+
+void IPDParser::endFrame()
+{
+	if (_ring != NULL) {
+		_ring->used += _number;
+		++_ring->frames;
+		_ring = NULL;
+	}
+	_state = S_LINE_START;
+}
+
+uint8_t IPDParser::passPrefix(char c)
+{
+	uint8_t n = _matched;
+
+	memcpy(_pass, IPD_PREFIX, n);
+	_pass[n++] = c;
+	_state = (c == '\n') ? S_LINE_START : S_LINE;
+
+	return n;
+}
+
+uint8_t IPDParser::feed(char c)
+{
+	switch (_state) {
+		case S_LINE_START:
+			if (c == IPD_PREFIX[0]) {
+				_state = S_PREFIX;
+				_matched = 1;
+				return 0;
+			}
+			if (c != '\n')
+				_state = S_LINE;
+			break;
+
+		case S_LINE:
+			if (c == '\n')
+				_state = S_LINE_START;
+			break;
+
+		case S_PREFIX:
+			if (c != IPD_PREFIX[_matched])
+				return passPrefix(c);
+			if (++_matched == IPD_PREFIX_LEN) {
+				_state = S_HEADER;
+				_link = -1;
+				_number = 0;
+				_matched = 0;	// Count the digits of the number
+			}
+			return 0;
+
+		case S_HEADER:
+			if (c >= '0' && c <= '9') {
+				_number = _number * 10 + (c - '0');
+				++_matched;
+				if (_number <= IPD_MAX_DATA_LEN)
+					return 0;
+			} else if (c == ',' && _link < 0 && _matched > 0 && _number < 10) {
+				_link = (int8_t)_number;
+				_number = 0;
+				_matched = 0;
+				return 0;
+			} else if (c == ':' && _matched > 0) {
+				if (_link < 0)	// Single connection mode
+					_link = 0;
+				_remain = _number;
+				beginFrame();
+				if (_remain == 0)
+					endFrame();
+				else
+					_state = S_DATA;
+				return 0;
+			}
+
+			// Malformed header, drop it.
+			++_malformed;
+			_state = (c == '\n') ? S_LINE_START : S_LINE;
+			return 0;
+
+		case S_DATA:
+			if (_ring != NULL)
+				putByte((uint8_t)c);
+			if (--_remain == 0)
+				endFrame();
+			return 0;
+	}
+
+	_pass[0] = c;
+	return 1;
+}
+
+uint8_t IPDParser::available() const
+{
+	uint8_t frames = 0;
+
+	for (uint8_t i = 0; i < IPD_MAX_LINKS; ++i)
+		frames += _rings[i].frames;
+
+	return frames;
+}
+
+int8_t IPDParser::pop(char * const msg, unsigned int buffLen, uint16_t *dataLen)
+{
+	for (uint8_t i = 0; i < IPD_MAX_LINKS; ++i) {
+		if (_rings[i].frames != 0)
+			return pop(i, msg, buffLen, dataLen);
+	}
+
+	return -1;
+}
+
+int8_t IPDParser::pop(uint8_t link, char * const msg, unsigned int buffLen, uint16_t *dataLen)
+{
+	FrameRing *ring;
+	uint16_t len, i;
+
+	if (link >= IPD_MAX_LINKS || _rings[link].frames == 0)
+		return -1;
+
+	ring = &_rings[link];
+	len = getByte(ring);
+	len |= (uint16_t)getByte(ring) << 8;
+
+	memset(msg, 0, buffLen);
+	--buffLen;	// 1 for null character
+	for (i = 0; i < len; ++i) {
+		if (i < buffLen)
+			msg[i] = (char)getByte(ring);
+		else
+			getByte(ring);
+	}
+
+	ring->used -= IPD_FRAME_HEADER_LEN + len;
+	--ring->frames;
+
+	if (dataLen)
+		*dataLen = len;
+	return (int8_t)link;
+}
+
+uint16_t IPDParser::read(uint8_t link, char *buf, uint16_t len)
+{
+	FrameRing *ring;
+	uint16_t n = 0, dataLen, take;
+
+	if (link >= IPD_MAX_LINKS)
+		return 0;
+
+	ring = &_rings[link];
+	while (n < len && ring->frames != 0) {
+		dataLen = getByte(ring);
+		dataLen |= (uint16_t)getByte(ring) << 8;
+
+		take = dataLen < len - n ? dataLen : len - n;
+		for (uint16_t i = 0; i < take; ++i)
+			buf[n++] = (char)getByte(ring);
+		ring->used -= take;
+
+		if (take == dataLen) {
+			ring->used -= IPD_FRAME_HEADER_LEN;
+			--ring->frames;
+		} else {
+			// Put the length of the rest in front of it, over the bytes just taken.
+			dataLen -= take;
+			ring->head = (ring->head + IPD_RING_SIZE - IPD_FRAME_HEADER_LEN) % IPD_RING_SIZE;
+			ring->data[ring->head] = (uint8_t)(dataLen & 0xFF);
+			ring->data[(ring->head + 1) % IPD_RING_SIZE] = (uint8_t)(dataLen >> 8);
+		}
+	}
+
+	return n;
+}
@@ -0,0 +1,209 @@
+/**
+ * @file KSM111_ESP8266/IPDParser.h
+ * @brief The header file of class IPDParser.
+ */
+#ifndef _IPD_PARSER_H_
+#define _IPD_PARSER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief The size of the ring buffer of a link for storing the received frames in bytes.
+ *
+ * Each frame takes 2 more bytes for its length.
+ * IPDParser.cpp doesn't see the defines of the sketch, so change it here.
+ */
+#define IPD_RING_SIZE 96
+
+/**
+ * @brief The number of links which have their own ring buffer, link ID 0 to IPD_MAX_LINKS - 1.
+ *
+ * The module supports up to 5 links in multiple connection mode.
+ * The frames from the other links are dropped.
+ * IPDParser.cpp doesn't see the defines of the sketch, so change it here.
+ */
+#define IPD_MAX_LINKS 2
+
+/**
+ * @brief The max length of the data in a +IPD frame sent by the module.
+ */
+#define IPD_MAX_DATA_LEN 2048
+
+/**
+ * @class IPDParser KSM111_ESP8266/IPDParser.h "IPDParser.h"
+ * @brief The incremental parser of the "+IPD,<id>,<len>:<data>" frames sent from the module.
+ *
+ * The bytes read from the module are fed one at a time. The bytes of a frame are
+ * consumed by the parser, and the complete frames are stored in the fixed ring buffer
+ * of their link.
+ * The other bytes, like the responses of AT commands and the unsolicited
+ * result codes ("CLOSED", "WIFI DISCONNECT"...), are passed back to the caller.
+ * A frame can be split over any number of <tt>feed()</tt> calls, and
+ * the frames arriving in the same burst are all kept.
+ *
+ * The class doesn't depend on Arduino, so it can also be built on the host.
+ */
+class IPDParser
+{
+	public:
+		IPDParser() { reset(); }
+
+		/**
+		 * @brief Drop all the stored frames and the frame in progress.
+		 */
+		void reset();
+
+		/**
+		 * @brief Feed a byte read from the module.
+		 *
+		 * The "+IPD," prefix is only matched at the beginning of a line.
+		 * If the following bytes don't match the prefix, the held bytes are passed back.
+		 *
+		 * @param c The byte read from the module.
+		 * @return The number of bytes which are not a part of a frame.
+		 *         These bytes are available in <tt>passed()</tt> until the next call.
+		 */
+		uint8_t feed(char c);
+
+		/**
+		 * @brief The bytes passed back by the last <tt>feed()</tt>.
+		 */
+		const char *passed() const { return _pass; }
+
+		/**
+		 * @brief Get the number of complete frames of all the links.
+		 */
+		uint8_t available() const;
+
+		/**
+		 * @brief Get the number of complete frames of the link.
+		 */
+		uint8_t available(uint8_t link) const
+		{ return link < IPD_MAX_LINKS ? _rings[link].frames : 0; }
+
+		/**
+		 * @brief Take a complete frame out of the ring buffers.
+		 *
+		 * The links are checked in the order of link ID.
+		 *
+		 * @param msg [out] The buffer for the data of the frame.
+		 * @param buffLen [in] The length of <tt>msg</tt> including null character.
+		 * @param dataLen [out] The length of the data of the frame. Could be NULL.
+		 * @return The link ID of the frame. In single connection mode, it's always 0.
+		 * @retval -1 There is no complete frame.
+		 */
+		int8_t pop(char * const msg, unsigned int buffLen, uint16_t *dataLen = NULL);
+
+		/**
+		 * @brief Take the oldest complete frame of the link out of its ring buffer.
+		 *
+		 * The rest of <tt>msg</tt> is filled with null characters.
+		 * If the data is longer than <tt>buffLen - 1</tt>, the rest of it is discarded.
+		 *
+		 * @param link [in] The link ID.
+		 * @param msg [out] The buffer for the data of the frame.
+		 * @param buffLen [in] The length of <tt>msg</tt> including null character.
+		 * @param dataLen [out] The length of the data of the frame, even if it's truncated. Could be NULL.
+		 * @return The link ID of the frame.
+		 * @retval -1 There is no complete frame of the link.
+		 */
+		int8_t pop(uint8_t link, char * const msg, unsigned int buffLen, uint16_t *dataLen = NULL);
+
+		/**
+		 * @brief Take the data of the link as a stream of bytes, regardless of the frames.
+		 *
+		 * The data is taken across the frames, and the rest of a frame partly taken
+		 * stays in the ring buffer for the next call. It's for the data carrying its own
+		 * delimiters, which may be split into or coalesced in the +IPD frames.
+		 *
+		 * @param link [in] The link ID.
+		 * @param buf [out] The buffer for the data. It's not terminated by null character.
+		 * @param len [in] The max number of bytes to take.
+		 * @return The number of bytes taken.
+		 */
+		uint16_t read(uint8_t link, char *buf, uint16_t len);
+
+		/**
+		 * @brief The number of frames dropped for the ring buffer being full
+		 *        or the link ID being out of range.
+		 */
+		uint16_t droppedFrames() const { return _dropped; }
+
+		/**
+		 * @brief The number of frames dropped for the malformed header.
+		 */
+		uint16_t malformedFrames() const { return _malformed; }
+
+	private:
+		/**
+		 * @brief The ring buffer of the frames of a link. Each frame is [length: 2 bytes][data].
+		 */
+		struct FrameRing {
+			uint8_t  data[IPD_RING_SIZE];
+			uint16_t head;		///< The first byte of the oldest frame
+			uint16_t used;		///< The number of bytes of the complete frames
+			uint8_t  frames;	///< The number of complete frames
+		};
+
+		/**
+		 * @brief Put a byte to the ring buffer of the frame in progress.
+		 */
+		void putByte(uint8_t b);
+
+		/**
+		 * @brief Get a byte from the head of the ring buffer.
+		 */
+		static uint8_t getByte(FrameRing *ring);
+
+		/**
+		 * @brief Start storing a frame if the ring buffer of its link has enough space.
+		 */
+		void beginFrame();
+
+		/**
+		 * @brief Publish the frame in progress.
+		 */
+		void endFrame();
+
+		/**
+		 * @brief Pass back the held prefix and the byte <tt>c</tt>.
+		 */
+		uint8_t passPrefix(char c);
+
+		/**
+		 * @brief The ring buffers of the links.
+		 */
+		FrameRing _rings[IPD_MAX_LINKS];
+
+		/**
+		 * @brief The ring buffer of the frame in progress. NULL if the frame is dropped.
+		 */
+		FrameRing *_ring;
+
+		/**
+		 * @brief The next byte of the frame in progress in <tt>_ring</tt>.
+		 */
+		uint16_t _write;
+
+		/**
+		 * @name Parsing state
+		 */
+		/** @{ */
+		uint8_t  _state;	///< The state of the parser
+		uint8_t  _matched;	///< The number of matched bytes of the prefix
+		int8_t   _link;		///< The link ID of the frame in progress
+		uint16_t _number;	///< The number being parsed in the header
+		uint16_t _remain;	///< The number of the data bytes not received yet
+		/** @} */
+
+		/**
+		 * @brief The buffer of the bytes passed back to the caller.
+		 */
+		char _pass[6];
+
+		uint16_t _dropped;
+		uint16_t _malformed;
+};
+
+#endif // _IPD_PARSER_H_
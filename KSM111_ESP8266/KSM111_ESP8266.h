@@ -6,9 +6,11 @@
 #define _KSM111_ESP8266_H_
 
 #include <stdint.h>
-#include <Stream.h>
-#include <SoftwareSerial.h>
-#include <HardwareSerial.h>
+#include <string.h>
+
+#include "SerialPort.h"
+#include "IPDParser.h"
+#include "CommandTrace.h"
 
 /* The mode of wifi */
 #define STATION 1
@@ -25,17 +27,55 @@
 /* Connection status */
 #define CONNECT_OK       0
 #define CONNECT_ERROR   -1
+#define CONNECT_TIMEOUT -2	// The module didn't response before the deadline
 #define ALREADY_CONNECT  1
 
+/* Link ID */
+#define LINK_SINGLE -1	// The only connection in single connection mode
+#define MAX_LINKS    5	// Link ID 0 to 4 in multiple connection mode
+
 /* Error Code from joining AP */
 #define JAP_OK 1
 #define ERR_JAP_TIMEOUT       -1	// Connection timeout
 #define ERR_JAP_WRONG_PASSWD  -2	// Wrong password
 #define ERR_JAP_AP_NOT_FOUND  -3	// Can not found target AP
 #define ERR_JAP_CONNECT_FAIL  -4	// Connect fail
+#define ERR_JAP_NO_RESPONSE   -5	// The module didn't response before the deadline
+
+/* The default deadline of the commands in milliseconds */
+#define TIMEOUT_DEFAULT   1000	// Used by the commands which have no deadline parameter
+#define TIMEOUT_RESET     5000
+#define TIMEOUT_LIST_AP  10000
+#define TIMEOUT_JOIN_AP  20000
+#define TIMEOUT_CONNECT   5000
+#define TIMEOUT_SEND      5000	// From the data written to "SEND OK"
+
+/* The width of the low pulse on the RST pin in milliseconds */
+#define RESET_PULSE_WIDTH 10
+
+/* Passthrough mode */
+#define PASSTHROUGH_GUARD_TIME 1000	// The silent time before and after "+++" in ms
+#define PASSTHROUGH_FRAME_GAP    20	// The idle time which ends a received message in ms
+
+/* Status of the AT command */
+#define CMD_IDLE     0	// No command has been sent
+#define CMD_PENDING  1	// Waiting for the terminal response
+#define CMD_OK       2	// "OK", "SEND OK", "ready" or the ">" prompt received
+#define CMD_LINE     3	// A response line is ready in the line-by-line mode
+#define CMD_ERROR   -1	// "ERROR" or "SEND FAIL" received
+#define CMD_FAIL    -2	// "FAIL" received
+#define CMD_TIMEOUT -3	// No terminal response before the deadline
 
-/* Serial type tag */
-enum {HARD, SOFT};
+/* Flags of the AT command */
+#define CMD_WAIT_PROMPT  0x01	// The ">" prompt terminates the command instead of "OK"
+#define CMD_LINE_BY_LINE 0x02	// Report every response line by CMD_LINE
+
+/**
+ * @brief The function called when an AT command is completed.
+ * @param status The final status of the command. CMD_OK, CMD_ERROR, CMD_FAIL, or CMD_TIMEOUT.
+ * @param response The response of the command.
+ */
+typedef void (*CommandCallback)(int8_t status, const char *response);
 
 /**
  * @struct AccessPointInfo KSM111_ESP8266/KSM111_ESP8266.h <KSM111_ESP8266.h>
@@ -50,10 +90,28 @@ typedef struct AccessPointInfo {
 } APInfo;
 
 /**
- * @class KSM111_ESP8266 KSM111_ESP8266.h <KSM111_ESP8266.h>
+ * @brief The default size of the buffer for the responses of the module in bytes.
+ */
+#define KSM111_BUFF_LEN 128
+
+/**
+ * @class KSM111_ESP8266T KSM111_ESP8266.h <KSM111_ESP8266.h>
  * @brief The basic class which directly communicating with the KSM111_ESP8266 module.
+ *
+ * The serial port and the size of the response buffer are decided at compile time.
+ * With SoftSerialPort or HardSerialPort, the serial I/O is called directly
+ * and nothing is allocated on the heap. For example:
+ *
+ *     KSM111_ESP8266T<SoftSerialPort, 96> wifi(10, 11);
+ *     KSM111_ESP8266T<HardSerialPort> wifi(&Serial1);
+ *
+ * @tparam Port The serial port: SoftSerialPort, HardSerialPort, or StreamPort.
+ * @tparam BUFF_LEN The size of <tt>_buff</tt> in bytes.
+ *         The responses longer than it are truncated.
+ * @tparam Trace The tracer: NoTrace or CommandTrace.
  */
-class KSM111_ESP8266 {
+template <class Port, uint16_t BUFF_LEN = KSM111_BUFF_LEN, class Trace = KSM111_DefaultTrace>
+class KSM111_ESP8266T {
 	public:
 		/**
 		 * @brief Initialize the pins of <tt>SoftwareSerial</tt> and <tt>_resetPin</tt>
@@ -61,14 +119,18 @@ class KSM111_ESP8266 {
 		 * @param txPin The number of pin connected to the RXD pin of the nodule.
 		 * @param resetPin [optional] ]The number of pin connected to the RST pin of the module.
 		 */
-		KSM111_ESP8266(int rxPin, int txPin, int resetPin = -1)
-			: _serial(new SoftwareSerial(rxPin, txPin)), _resetPin(resetPin), _serialType(SOFT) {}
+		KSM111_ESP8266T(int rxPin, int txPin, int resetPin = -1)
+			: _serial(rxPin, txPin), _resetPin(resetPin), _buffLen(0), _lineStart(0), _heldLen(0),
+			  _cmdStatus(CMD_IDLE), _cmdFlags(0), _cmdStart(0), _cmdTimeout(0), _cmdCallback(NULL), _timeouts(0),
+			  _defaultTimeout(TIMEOUT_DEFAULT), _sendTimeout(TIMEOUT_SEND), _passthrough(false) {}
 
 		/**
 		 * @brief Constructor for using <tt>HardwareSerial</tt> to communicate with module.
 		 */
-		KSM111_ESP8266(HardwareSerial *hws, int resetPin = -1)
-			: _serial(hws), _resetPin(resetPin), _serialType(HARD) {}
+		KSM111_ESP8266T(HardwareSerial *hws, int resetPin = -1)
+			: _serial(hws), _resetPin(resetPin), _buffLen(0), _lineStart(0), _heldLen(0),
+			  _cmdStatus(CMD_IDLE), _cmdFlags(0), _cmdStart(0), _cmdTimeout(0), _cmdCallback(NULL), _timeouts(0),
+			  _defaultTimeout(TIMEOUT_DEFAULT), _sendTimeout(TIMEOUT_SEND), _passthrough(false) {}
 
 		/**
 		 * @brief Set the buadrate of <tt>_serial</tt> and begin it
@@ -82,22 +144,116 @@ class KSM111_ESP8266 {
 		 */
 		void end();
 
+		/**
+		 * @name Asynchronous AT command
+		 * Send an AT command and poll its response without blocking.
+		 *
+		 * All the other methods are the blocking wrappers of these operations.
+		 */
+		/** @{ */
+		/**
+		 * @brief Send an AT command to the module without waiting for the response.
+		 *
+		 * The response is collected by <tt>pollCommand()</tt> until a terminal token
+		 * ("OK", "SEND OK", "ERROR", "SEND FAIL", "FAIL", or "ready") arrives,
+		 * or the deadline passed.
+		 *
+		 * @param cmd The AT command without "\r\n".
+		 * @param timeout The deadline of the command in milliseconds.
+		 * @param flags [optional] CMD_WAIT_PROMPT and/or CMD_LINE_BY_LINE.
+		 * @return false if there is another command in progress.
+		 */
+		bool sendCommand(const char *cmd, unsigned long timeout, uint8_t flags = 0);
+		/**
+		 * @brief Collect the incoming response of the command sent by <tt>sendCommand()</tt>.
+		 *
+		 * The method only reads the bytes already in the serial buffer, and never waits.
+		 * The callback set by <tt>onCommandComplete()</tt> is invoked when the command is completed.
+		 *
+		 * @return The status of the command.
+		 * @retval CMD_PENDING The terminal response hasn't arrived yet.
+		 * @retval CMD_LINE A response line is ready in <tt>commandResponse()</tt>. Only in CMD_LINE_BY_LINE mode.
+		 * @retval CMD_OK, CMD_ERROR, CMD_FAIL, CMD_TIMEOUT The command is completed.
+		 */
+		int8_t pollCommand();
+		/**
+		 * @brief Poll the command until it is completed.
+		 * @return The final status of the command.
+		 */
+		int8_t waitCommand();
+		/**
+		 * @brief Get the status of the last command without polling.
+		 */
+		int8_t commandStatus() const { return _cmdStatus; }
+		/**
+		 * @brief Get the response collected so far.
+		 *
+		 * In CMD_LINE_BY_LINE mode, it is the latest response line.
+		 */
+		const char *commandResponse() const { return _buff; }
+		/**
+		 * @brief Set the function to be called when a command is completed.
+		 * @param callback The callback function. NULL to disable it.
+		 */
+		void onCommandComplete(CommandCallback callback) { _cmdCallback = callback; }
+		/**
+		 * @brief Set the deadline of the commands which have no deadline parameter.
+		 *
+		 * If a blocking method returns false, <tt>commandStatus()</tt> tells whether
+		 * the module responsed an error or didn't response in time (CMD_TIMEOUT).
+		 *
+		 * @param ms The deadline in milliseconds. Default is TIMEOUT_DEFAULT.
+		 */
+		void setCommandTimeout(unsigned long ms) { _defaultTimeout = ms; }
+		/**
+		 * @brief Set the deadline of waiting for "SEND OK" in <tt>puts()</tt>.
+		 * @param ms The deadline in milliseconds. Default is TIMEOUT_SEND.
+		 */
+		void setSendTimeout(unsigned long ms) { _sendTimeout = ms; }
+		/**
+		 * @brief Get the number of the commands timed out in a row.
+		 *
+		 * It's reset to 0 once the module responses a command.
+		 * Several timeouts in a row mean the module stops answering.
+		 */
+		uint8_t consecutiveTimeouts() const { return _timeouts; }
+		/** @} */
+
+		/**
+		 * @brief Get the tracer, for example, to dump the events and the latencies.
+		 */
+		Trace &trace() { return _trace; }
+
 		/**
 		 * @brief Restart the module by AT command.
-		 *        It takes 5 seconds to wait for restarting.
-		 * @return true if the module responses "OK"
+		 *        It returns after the module responses "ready", or the deadline passed.
+		 * @param timeout [optional] The deadline of restarting in milliseconds.
+		 * @return true if the module responses "OK" and then "ready"
+		 */
+		bool softReset(unsigned long timeout = TIMEOUT_RESET);
+
+		/**
+		 * @brief Restart the module by pulsing the RST pin.
+		 *
+		 * It works even if the module stops answering AT commands.
+		 * The command in progress and the passthrough mode are abandoned, and the
+		 * received messages are dropped. It returns once the module responses "ready".
+		 * If there is no <tt>_resetPin</tt>, it calls <tt>softReset()</tt> instead.
+		 *
+		 * @param timeout [optional] The deadline of restarting in milliseconds.
+		 * @return true if the module responses "ready" before the deadline.
 		 */
-		bool softReset();
+		bool hardReset(unsigned long timeout = TIMEOUT_RESET);
 
 		/**
-		 * @brief Set the operating mode of the module. The method spends 0.5 seconds.
+		 * @brief Set the operating mode of the module.
 		 * @param mode The operating mode: STATION, AP, or BOTH
 		 * @return true if the module responses "OK"
 		 */
 		bool setMode(uint8_t mode);
 
 		/**
-		 * @brief Get the operating mode of the module. The method spends 0.1 seconds.
+		 * @brief Get the operating mode of the module.
 		 * @return The operating mode
 		 */
 		uint8_t getMode();
@@ -120,26 +276,30 @@ class KSM111_ESP8266 {
 		 */
 		/** @{ */
 		/**
-		 * @brief List avalible access points. The method spends 5 seconds.
+		 * @brief List avalible access points.
 		 * @param apList [out] Store the information of access points
 		 * @param count [in] The max amount of listing access points
 		 * @param vaildCount [out] The number of vaild access points in <tt>apList</tt>.
+		 * @param timeout [optional] The deadline of searching in milliseconds.
 		 * @return true if the responsing message contains "OK".
 		 *         If the device is in AP mode, it will responses "ERROR".
 		 */
-		bool listAP(APInfo *apList, int count, int *vaildCount);
+		bool listAP(APInfo *apList, int count, int *vaildCount,
+		            unsigned long timeout = TIMEOUT_LIST_AP);
 		/**
-		 * @brief Join an AP. The method spends 8 seconds.
+		 * @brief Join an AP. The method returns once the module got the IP.
 		 * @param ssid The ssid of the AP
 		 * @param passwd The password of the AP
+		 * @param timeout [optional] The deadline of joining in milliseconds.
 		 * @return The connection status of joining AP
 		 * @retval JAP_OK Success
 		 * @retval ERR_JAP_TIMEOUT Connecting timeout
 		 * @retval ERR_JAP_WRONG_PASSWD Wrong passwrod
 		 * @retval ERR_JAP_AP_NOT_FOUND Can not found target AP
 		 * @retval ERR_JAP_CONNECT_FAIL Connect fail
+		 * @retval ERR_JAP_NO_RESPONSE The module didn't response before the deadline
 		 */
-		int8_t joinAP(const char *ssid, const char *passwd);
+		int8_t joinAP(const char *ssid, const char *passwd, unsigned long timeout = TIMEOUT_JOIN_AP);
 		/**
 		 * @brief Check if there is any joined AP
 		 * @param ssid The ssid of joined AP if any.
@@ -168,12 +328,31 @@ class KSM111_ESP8266 {
 		 * @param type "TCP" or "UDP"
 		 * @param ip The ip of the server
 		 * @param port The port number of the server
+		 * @param timeout [optional] The deadline of connecting in milliseconds.
 		 * @return The status of the connection
 		 * @retval CONNECT_OK Success
 		 * @retval CONNECT_ERROR Failed
+		 * @retval CONNECT_TIMEOUT The module didn't response before the deadline
 		 * @retval ALREADY_CONNECT Already connect to this server
 		 */
-		uint8_t beginClient(const char *type, const char *ip, const int port);
+		int8_t beginClient(const char *type, const char *ip, const int port,
+		                   unsigned long timeout = TIMEOUT_CONNECT)
+		{ return beginClient(LINK_SINGLE, type, ip, port, timeout); }
+		/**
+		 * @brief Establish the connection on the specified link in multiple connection mode.
+		 * @param linkID The link ID from 0 to MAX_LINKS - 1, or LINK_SINGLE in single connection mode.
+		 * @param type "TCP" or "UDP"
+		 * @param ip The ip of the server
+		 * @param port The port number of the server
+		 * @param timeout [optional] The deadline of connecting in milliseconds.
+		 * @return The status of the connection
+		 * @retval CONNECT_OK Success
+		 * @retval CONNECT_ERROR Failed
+		 * @retval CONNECT_TIMEOUT The module didn't response before the deadline
+		 * @retval ALREADY_CONNECT Already connect to this server
+		 */
+		int8_t beginClient(int8_t linkID, const char *type, const char *ip, const int port,
+		                   unsigned long timeout = TIMEOUT_CONNECT);
 
 		/**
 		 * @brief Check if the connection to the TCP server is still alive.
@@ -182,47 +361,199 @@ class KSM111_ESP8266 {
 		bool isClientConnected();
 
 		/**
-		 * @brief Disconnect from the server but not quiting AP. Th method spends 0.25 seconds.
+		 * @brief Disconnect from the server but not quiting AP.
 		 * @return True if successfully disconnected
 		 */
-		bool endClient();
+		bool endClient() { return endClient(LINK_SINGLE); }
+		/**
+		 * @brief Close the connection on the specified link.
+		 * @param linkID The link ID, or LINK_SINGLE in single connection mode.
+		 * @return True if successfully disconnected
+		 */
+		bool endClient(int8_t linkID);
 
 		/**
-		 * @brief Get the IP address of the station or softAP. This method spends 0.5 seconds.
+		 * @brief Get the IP address of the station or softAP.
 		 * @param mode STATION or AP (softAP) mode
 		 * @param ip [out] The IP address
 		 */
 		void getIP(uint8_t mode, char *ip);
 
+		/**
+		 * @name Passthrough mode
+		 * The transparent transmission mode. The bytes written to the module are sent
+		 * to the server directly, and vice versa. There is no AT+CIPSEND handshake
+		 * for each message.
+		 */
+		/** @{ */
+		/**
+		 * @brief Enter the passthrough mode.
+		 *
+		 * Only available in single connection mode with a connected TCP or UDP client.
+		 * No AT command can be sent until <tt>endPassthrough()</tt> is called.
+		 *
+		 * @return true if the module is ready to transmit.
+		 */
+		bool beginPassthrough();
+		/**
+		 * @brief Leave the passthrough mode by "+++" and return to the command mode.
+		 *
+		 * It takes 2 * PASSTHROUGH_GUARD_TIME milliseconds for the module to recognize "+++".
+		 *
+		 * @return true if the module leaves the passthrough mode.
+		 */
+		bool endPassthrough();
+		/**
+		 * @brief Check if the module is in the passthrough mode.
+		 */
+		bool isPassthrough() const { return _passthrough; }
+		/** @} */
+
 		/**
 		 * @brief Send a message to server.
 		 *
 		 * Note that this function can be only used in the client.
+		 * In the passthrough mode, the message is written to the module directly.
 		 *
 		 * @param msg [input] The message wants to passed to AP
 		 * @return True if it sends successfully
 		 */
-		 bool puts(const char *msg);
+		 bool puts(const char *msg) { return puts(msg, strlen(msg)); }
+		/**
+		 * @brief Send the data of the specified length to server.
+		 *
+		 * The data can contain null characters.
+		 *
+		 * @param msg [input] The data wants to passed to AP
+		 * @param msgLen [input] The length of the data. At most 2048 bytes.
+		 * @return True if it sends successfully
+		 */
+		 bool puts(const char *msg, unsigned int msgLen) { return puts(LINK_SINGLE, msg, msgLen); }
+		/**
+		 * @brief Send a message on the specified link.
+		 * @param linkID The link ID, or LINK_SINGLE in single connection mode.
+		 * @param msg [input] The message wants to passed to AP
+		 * @return True if it sends successfully
+		 */
+		 bool puts(int8_t linkID, const char *msg) { return puts(linkID, msg, strlen(msg)); }
+		/**
+		 * @brief Send the data of the specified length on the specified link.
+		 * @param linkID The link ID, or LINK_SINGLE in single connection mode.
+		 * @param msg [input] The data wants to passed to AP
+		 * @param msgLen [input] The length of the data. At most 2048 bytes.
+		 * @return True if it sends successfully
+		 */
+		 bool puts(int8_t linkID, const char *msg, unsigned int msgLen);
 
 		 /**
 		  * @brief Receive the message sent from the server.
+		  *
+		  * The incoming bytes are parsed as they arrive, so the method never waits.
+		  * If several messages arrived in the same burst, they are returned one per call.
+		  * In the passthrough mode, a message ends when there is no incoming byte
+		  * for PASSTHROUGH_FRAME_GAP milliseconds.
+		  *
 		  * @param msg [out] The buffer for receiving message
 		  * @param buffLen [in] The max length of the buffer _msg_ including null character.
+		  * @param msgLen [out] The length of the message as received, which could contain
+		  *        null characters or be longer than _msg_. Could be NULL.
 		  * @return The ID of the sender. In single conenction mode, it always returns 0.
 		  * @retval -1 There is no incoming message.
 		  */
-		 int8_t gets(char * const msg, unsigned int buffLen);
+		 int8_t gets(char * const msg, unsigned int buffLen, unsigned int *msgLen = NULL);
+
+		 /**
+		  * @brief Receive the message from the specified link.
+		  *
+		  * Each link has its own receive queue, so the messages of the other links are kept.
+		  * Only the links from 0 to IPD_MAX_LINKS - 1 are received.
+		  *
+		  * @param linkID The link ID, or LINK_SINGLE in single connection mode.
+		  * @param msg [out] The buffer for receiving message
+		  * @param buffLen [in] The max length of the buffer _msg_ including null character.
+		  * @param msgLen [out] The length of the message as received. Could be NULL.
+		  * @return The link ID of the message. In single connection mode, it always returns 0.
+		  * @retval -1 There is no incoming message on the link.
+		  */
+		 int8_t gets(int8_t linkID, char * const msg, unsigned int buffLen, unsigned int *msgLen = NULL);
+
+		 /**
+		  * @brief Read the received data of the specified link as a stream of bytes.
+		  *
+		  * Unlike <tt>gets()</tt>, the bytes are taken regardless of the +IPD frames,
+		  * so a message split into several frames, or several messages in a frame,
+		  * can be read by the length of the message. It never waits.
+		  *
+		  * @param linkID The link ID, or LINK_SINGLE in single connection mode.
+		  * @param buf [out] The buffer for the bytes. It's not terminated by null character.
+		  * @param len [in] The max number of bytes to read.
+		  * @return The number of bytes read.
+		  */
+		 unsigned int read(int8_t linkID, char *buf, unsigned int len);
 
 	private:
 		/**
-		 * @brief The interface for communicating with the module.
+		 * @brief Start collecting the response without sending a command.
+		 *
+		 * It's used for waiting for the result of the data written after the ">" prompt.
 		 */
-		Stream *_serial;
+		void expectResponse(unsigned long timeout, uint8_t flags);
 
 		/**
-		 * @brief Record either SoftwareSerial or HarewareSerial is in use.
+		 * @brief Check if the response line is a terminal token.
+		 * @param line The null-terminated response line without "\r\n".
+		 * @return CMD_PENDING if it's not a terminal token. Otherwise, the final status.
+		 */
+		int8_t checkLine(const char *line);
+
+		/**
+		 * @brief Append a byte of response to <tt>_buff</tt> and check the completed line.
+		 * @return The status of the command after the byte.
+		 */
+		int8_t collectResponse(char ch);
+
+		/**
+		 * @brief Update the status of the command.
+		 *
+		 * If the command is completed, invoke the callback.
+		 */
+		void completeCommand(int8_t status);
+
+		/**
+		 * @brief Read all the available bytes from the module.
+		 *
+		 * The +IPD frames are stored in <tt>_ipd</tt>, and the other bytes are
+		 * collected as the response of the command in progress.
+		 * The bytes are dropped if there is no command in progress.
+		 * If a line is waiting to be taken, the response bytes are held by <tt>holdResponse()</tt>.
 		 */
-		int _serialType;
+		void receive();
+
+		/**
+		 * @brief Keep a response byte after the line of CMD_LINE. It's dropped if <tt>_buff</tt> is full.
+		 */
+		void holdResponse(char ch);
+
+		/**
+		 * @brief Collect the held response bytes after the line of CMD_LINE is taken.
+		 */
+		void replayHeld();
+
+		/**
+		 * @brief The <tt>gets()</tt> in the passthrough mode.
+		 */
+		int8_t getsPassthrough(char * const msg, unsigned int buffLen, unsigned int *msgLen);
+
+		/**
+		 * @brief Record the message returned by <tt>gets()</tt> to <tt>_trace</tt>.
+		 * @param len The length of the message as received.
+		 */
+		void traceReceived(int8_t linkID, uint16_t len, unsigned long start);
+
+		/**
+		 * @brief The interface for communicating with the module.
+		 */
+		Port _serial;
 
 		/**
 		 * @brief The number of pin which is connected to the RST pin of the module.
@@ -232,7 +563,96 @@ class KSM111_ESP8266 {
 		/**
 		 * @brief The buffer for temporarily storing the message.
 		 */
-		char _buff[128];
+		char _buff[BUFF_LEN];
+
+		/**
+		 * @brief The number of bytes stored in <tt>_buff</tt>.
+		 */
+		uint16_t _buffLen;
+
+		/**
+		 * @brief The index of the first byte of the current response line in <tt>_buff</tt>.
+		 */
+		uint16_t _lineStart;
+
+		/**
+		 * @brief The number of response bytes received after the line of CMD_LINE.
+		 *
+		 * They are kept in <tt>_buff</tt> after the null character of the line
+		 * until the line is taken.
+		 */
+		uint16_t _heldLen;
+
+		/**
+		 * @brief The status of the last command.
+		 */
+		int8_t _cmdStatus;
+
+		/**
+		 * @brief The flags of the last command.
+		 */
+		uint8_t _cmdFlags;
+
+		/**
+		 * @brief The time when the last command was sent, in milliseconds.
+		 */
+		unsigned long _cmdStart;
+
+		/**
+		 * @brief The deadline of the last command, in milliseconds.
+		 */
+		unsigned long _cmdTimeout;
+
+		/**
+		 * @brief The function called when a command is completed.
+		 */
+		CommandCallback _cmdCallback;
+
+		/**
+		 * @brief The number of the commands timed out in a row.
+		 */
+		uint8_t _timeouts;
+
+		/**
+		 * @brief The deadline of the commands which have no deadline parameter.
+		 */
+		unsigned long _defaultTimeout;
+
+		/**
+		 * @brief The deadline of waiting for "SEND OK".
+		 */
+		unsigned long _sendTimeout;
+
+		/**
+		 * @brief The parser and the storage of the incoming +IPD frames.
+		 */
+		IPDParser _ipd;
+
+		/**
+		 * @brief Whether the module is in the passthrough mode.
+		 */
+		bool _passthrough;
+
+		/**
+		 * @brief The time when the last byte arrived in the passthrough mode.
+		 */
+		unsigned long _lastByteTime;
+
+		/**
+		 * @brief The recorder of the events and the latencies.
+		 */
+		Trace _trace;
 };
 
+/**
+ * @brief The compatibility name of the class, which decides the serial type at runtime.
+ *
+ * The members are instantiated once in KSM111_ESP8266.cpp.
+ */
+typedef KSM111_ESP8266T<StreamPort> KSM111_ESP8266;
+
+#include "KSM111_ESP8266Impl.h"
+
+extern template class KSM111_ESP8266T<StreamPort>;
+
 #endif // _KSM111_ESP8266_H_
@@ -0,0 +1,722 @@
+/**
+ * @file KSM111_ESP8266/KSM111_ESP8266Impl.h
+ * @brief The member definitions of class template KSM111_ESP8266T.
+ *
+ * It's included at the end of KSM111_ESP8266.h. Don't include it directly.
+ */
+#ifndef _KSM111_ESP8266_IMPL_H_
+#define _KSM111_ESP8266_IMPL_H_
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Define KSM111_DEBUG to print the commands and the responses through Serial.
+#ifdef KSM111_DEBUG
+ #define KSM111_DEBUG_STR(x) Serial.print("# "); Serial.println(x)
+#else
+ #define KSM111_DEBUG_STR(X)
+#endif
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+bool KSM111_ESP8266T<Port, BUFF_LEN, Trace>::sendCommand(const char *cmd, unsigned long timeout, uint8_t flags)
+{
+	if (_passthrough ||
+	    _cmdStatus == CMD_PENDING || _cmdStatus == CMD_LINE)
+		return false;
+
+	KSM111_DEBUG_STR(cmd);
+	_serial.println(cmd);
+	_trace.commandSent(strlen(cmd));
+	expectResponse(timeout, flags);
+
+	return true;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+void KSM111_ESP8266T<Port, BUFF_LEN, Trace>::expectResponse(unsigned long timeout, uint8_t flags)
+{
+	_buffLen = _lineStart = _heldLen = 0;
+	_buff[0] = '\0';
+	_cmdFlags = flags;
+	_cmdTimeout = timeout;
+	_cmdStart = millis();
+	_cmdStatus = CMD_PENDING;
+	_trace.responseExpected();
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+int8_t KSM111_ESP8266T<Port, BUFF_LEN, Trace>::checkLine(const char *line)
+{
+	if (strcmp(line, "OK") == 0)
+		return (_cmdFlags & CMD_WAIT_PROMPT) ? CMD_PENDING : CMD_OK;
+	if (strcmp(line, "SEND OK") == 0 || strcmp(line, "ready") == 0)
+		return CMD_OK;
+	if (strcmp(line, "ERROR") == 0 || strcmp(line, "SEND FAIL") == 0)
+		return CMD_ERROR;
+	if (strcmp(line, "FAIL") == 0)
+		return CMD_FAIL;
+
+	return CMD_PENDING;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+int8_t KSM111_ESP8266T<Port, BUFF_LEN, Trace>::collectResponse(char ch)
+{
+	int8_t status;
+
+	// The ">" prompt is not followed by a new line.
+	if (ch == '>' && (_cmdFlags & CMD_WAIT_PROMPT) &&
+	    _buffLen == _lineStart)
+		return CMD_OK;
+
+	if (ch == '\r')
+		return CMD_PENDING;
+	if (ch != '\n') {
+		// Drop the previous lines if the buffer is full.
+		if (_buffLen == sizeof(_buff) - 1 && _lineStart > 0) {
+			_buffLen -= _lineStart;
+			memmove(_buff, _buff + _lineStart, _buffLen);
+			_lineStart = 0;
+		}
+		// Truncate the line which is too long.
+		if (_buffLen < sizeof(_buff) - 1)
+			_buff[_buffLen++] = ch;
+		return CMD_PENDING;
+	}
+
+	// Skip empty lines
+	if (_buffLen == _lineStart)
+		return CMD_PENDING;
+
+	_buff[_buffLen] = '\0';
+	status = checkLine(_buff + _lineStart);
+	if (status == CMD_PENDING) {
+		if (_cmdFlags & CMD_LINE_BY_LINE)
+			status = CMD_LINE;
+		else if (_buffLen < sizeof(_buff) - 1)
+			_buff[_buffLen++] = '\n';	// Keep the line in the response
+	}
+	_lineStart = _buffLen;
+
+	return status;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+void KSM111_ESP8266T<Port, BUFF_LEN, Trace>::completeCommand(int8_t status)
+{
+	_cmdStatus = status;
+	_buff[_buffLen] = '\0';
+	if (status == CMD_PENDING || status == CMD_LINE)
+		return;
+
+	if (status == CMD_TIMEOUT) {
+		if (_timeouts < 0xFF)
+			++_timeouts;
+	} else
+		_timeouts = 0;
+
+	KSM111_DEBUG_STR(_buff);
+	_trace.commandDone(status, _buffLen);
+	if (_cmdCallback)
+		_cmdCallback(status, _buff);
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+void KSM111_ESP8266T<Port, BUFF_LEN, Trace>::receive()
+{
+	uint8_t n, i;
+
+	while (_serial.available()) {
+		// The bytes of +IPD frames are kept by _ipd,
+		// and the others are the response of the command.
+		n = _ipd.feed(_serial.read());
+		if (_cmdStatus == CMD_PENDING)
+			_trace.responseByte();
+		for (i = 0; i < n; ++i) {
+			if (_cmdStatus == CMD_PENDING)
+				completeCommand(collectResponse(_ipd.passed()[i]));
+			else if (_cmdStatus == CMD_LINE)	// The caller has to take the line first.
+				holdResponse(_ipd.passed()[i]);
+			else
+				break;
+		}
+	}
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+void KSM111_ESP8266T<Port, BUFF_LEN, Trace>::holdResponse(char ch)
+{
+	if (_buffLen + _heldLen < sizeof(_buff) - 1)
+		_buff[_buffLen + 1 + _heldLen++] = ch;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+void KSM111_ESP8266T<Port, BUFF_LEN, Trace>::replayHeld()
+{
+	uint16_t held = _heldLen, i;
+	char *from = _buff + sizeof(_buff) - held;
+
+	// Move the held bytes to the end, so the new line never reaches the ones not collected yet.
+	memmove(from, _buff + _buffLen + 1, held);
+	_buffLen = _lineStart = _heldLen = 0;
+	_buff[0] = '\0';
+	_cmdStatus = CMD_PENDING;
+
+	for (i = 0; i < held && _cmdStatus == CMD_PENDING; ++i)
+		completeCommand(collectResponse(from[i]));
+
+	if (_cmdStatus == CMD_LINE && i < held) {
+		_heldLen = held - i;
+		memmove(_buff + _buffLen + 1, from + i, _heldLen);
+	}
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+int8_t KSM111_ESP8266T<Port, BUFF_LEN, Trace>::pollCommand()
+{
+	if (_cmdStatus == CMD_LINE) {	// The previous line has been consumed.
+		replayHeld();
+		if (_cmdStatus == CMD_LINE)
+			return _cmdStatus;
+	}
+
+	receive();
+
+	if (_cmdStatus == CMD_PENDING &&
+	    millis() - _cmdStart >= _cmdTimeout)
+		completeCommand(CMD_TIMEOUT);
+
+	return _cmdStatus;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+int8_t KSM111_ESP8266T<Port, BUFF_LEN, Trace>::waitCommand()
+{
+	int8_t status;
+
+	while ((status = pollCommand()) == CMD_PENDING)
+		;
+
+	return status;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+bool KSM111_ESP8266T<Port, BUFF_LEN, Trace>::begin(long baudrate)
+{
+	// Set _resetPin to HIGH to avoid resetting the module.
+	if (_resetPin > 0) {
+		pinMode(_resetPin, OUTPUT);
+		digitalWrite(_resetPin, HIGH);
+	}
+
+	// Initialize the Serial
+	_serial.begin(baudrate);
+
+	// Wake up the wifi module.
+	/* Response: "OK"
+	 */
+	return sendCommand("AT", _defaultTimeout) && waitCommand() == CMD_OK;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+void KSM111_ESP8266T<Port, BUFF_LEN, Trace>::end()
+{
+	_serial.end();
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+bool KSM111_ESP8266T<Port, BUFF_LEN, Trace>::softReset(unsigned long timeout)
+{
+	/* Response: "AT+RST
+	 *          \nOK
+	 *            <Tons of message>
+	 *            ready"
+	 */
+	if (!sendCommand("AT+RST", _defaultTimeout) || waitCommand() != CMD_OK)
+		return false;
+
+	// Wait for the module restarting
+	expectResponse(timeout, 0);
+
+	return waitCommand() == CMD_OK;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+bool KSM111_ESP8266T<Port, BUFF_LEN, Trace>::hardReset(unsigned long timeout)
+{
+	if (_resetPin <= 0)
+		return softReset(timeout);
+
+	KSM111_DEBUG_STR("HARD RESET");
+	// Abandon the state of the module before the reset
+	_passthrough = false;
+	_ipd.reset();
+
+	digitalWrite(_resetPin, LOW);
+	delay(RESET_PULSE_WIDTH);
+	while (_serial.available())
+		_serial.read();
+	digitalWrite(_resetPin, HIGH);
+
+	/* Response: "<Tons of message>
+	 *            ready"
+	 */
+	expectResponse(timeout, 0);
+
+	return waitCommand() == CMD_OK;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+bool KSM111_ESP8266T<Port, BUFF_LEN, Trace>::setMode(uint8_t mode)
+{
+	char cmd[16];
+
+	sprintf(cmd, "AT+CWMODE=%d", mode);
+
+	/* Response "AT+CWMODE=<mode>
+	 *         \nOK" */
+	return sendCommand(cmd, _defaultTimeout) && waitCommand() == CMD_OK;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+uint8_t KSM111_ESP8266T<Port, BUFF_LEN, Trace>::getMode()
+{
+	char *ch;
+
+	if (!sendCommand("AT+CWMODE?", _defaultTimeout) || waitCommand() != CMD_OK)
+		return -1;
+
+	/* Response: "AT+CWMODE?
+	 *            +CWMODE:<mode>
+	 *          \nOK"
+	 */
+	if ((ch = strstr(_buff, ":")) != NULL) {
+		switch (*++ch) {
+			case '1':
+				return STATION;
+			case '2':
+				return AP;
+			case '3':
+				return BOTH;
+		}
+	}
+
+	return -1;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+bool KSM111_ESP8266T<Port, BUFF_LEN, Trace>::setBaudrate(long baudrate)
+{
+	char cmd[24];
+
+	sprintf(cmd, "AT+CIOBAUD=%ld", baudrate);
+	if (!sendCommand(cmd, _defaultTimeout))
+		return false;
+	_serial.begin(baudrate);
+
+	if (waitCommand() == CMD_OK) {
+		_serial.begin(baudrate);
+
+		return true;
+	}
+
+	return false;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+bool KSM111_ESP8266T<Port, BUFF_LEN, Trace>::listAP(APInfo *apList, int count, int *vaildCount, unsigned long timeout)
+{
+	int8_t status;
+	int i = 0;
+	APInfo apInfo;
+
+	if (apList == NULL || count < 1)
+		return false;
+
+	if (!sendCommand("AT+CWLAP", timeout, CMD_LINE_BY_LINE))
+		return false;
+
+	// Read the response line by line until responsing with OK or ERROR
+	while ((status = pollCommand()) == CMD_PENDING || status == CMD_LINE) {
+		if (status != CMD_LINE || !strstr(_buff, "+CWLAP:("))
+			continue;
+
+		KSM111_DEBUG_STR(_buff);
+		strtok(_buff, "(),\"");	// Ignore +CWLAP:
+		apInfo.encrypt = atoi(strtok(NULL, "(),\""));
+		strcpy(apInfo.ssid, strtok(NULL, "(),\""));
+		apInfo.rssi = atoi(strtok(NULL, "(),\""));
+		strcpy(apInfo.mac, strtok(NULL, "(),\""));
+		apInfo.ch = atoi(strtok(NULL, "(),\""));
+
+		if (i < count)
+			apList[i++] = apInfo;
+	}
+
+	if (vaildCount != NULL)
+		*vaildCount = i;
+	return status == CMD_OK;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+int8_t KSM111_ESP8266T<Port, BUFF_LEN, Trace>::joinAP(const char *ssid, const char *passwd, unsigned long timeout)
+{
+	char cmd[96], *ch;
+
+	sprintf(cmd, "AT+CWJAP=\"%s\",\"%s\"", ssid, passwd);
+	// Wait for the final "OK" after "WIFI GOT IP". The module is busy until then,
+	// and an "OK" left behind would end the next command.
+	if (!sendCommand(cmd, timeout))
+		return ERR_JAP_CONNECT_FAIL;
+
+	/* Response: "WIFI CONNECTED
+	 *            WIFI GOT IP
+	 *          \nOK"
+	 * or        "+CWJAP:<error code>
+	 *          \nFAIL"
+	 */
+	switch (waitCommand()) {
+		case CMD_OK:
+			return JAP_OK;
+		case CMD_TIMEOUT:
+			return ERR_JAP_NO_RESPONSE;
+		case CMD_FAIL:
+			if ((ch = strstr(_buff, "+CWJAP:")) == NULL)
+				break;
+			switch (ch[7]) {	// Move to error code
+				case '1':
+					return ERR_JAP_TIMEOUT;
+				case '2':
+					return ERR_JAP_WRONG_PASSWD;
+				case '3':
+					return ERR_JAP_AP_NOT_FOUND;
+				case '4':
+					return ERR_JAP_CONNECT_FAIL;
+			}
+			break;
+	}
+
+	return ERR_JAP_CONNECT_FAIL;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+bool KSM111_ESP8266T<Port, BUFF_LEN, Trace>::joinedAP(char * const ssid)
+{
+	char *ch, *ssidCh = ssid;
+
+	if (!sendCommand("AT+CWJAP?", _defaultTimeout) || waitCommand() != CMD_OK)
+		return false;
+
+	// Parse the information
+	if (ch = strstr(_buff, "+CWJAP:\"")) {
+		ch += 8;
+		while (*ch != '\"' && *ch != '\0') {
+			*ssidCh++ = *ch++;
+		}
+		return true;
+	} else {
+		return false;
+	}
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+void KSM111_ESP8266T<Port, BUFF_LEN, Trace>::quitAP()
+{
+	if (sendCommand("AT+CWQAP", _defaultTimeout))
+		waitCommand();
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+bool KSM111_ESP8266T<Port, BUFF_LEN, Trace>::multiConnect(bool mode)
+{
+	char cmd[16];
+
+	sprintf(cmd, "AT+CIPMUX=%d", mode ? 1 : 0 );
+
+	return sendCommand(cmd, _defaultTimeout) && waitCommand() == CMD_OK;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+int8_t KSM111_ESP8266T<Port, BUFF_LEN, Trace>::beginClient(int8_t linkID, const char *type, const char *ip, const int port,
+                                   unsigned long timeout)
+{
+	char cmd[64];
+	unsigned long start = _trace.now();
+	int8_t status;
+
+	if (linkID == LINK_SINGLE)
+		sprintf(cmd, "AT+CIPSTART=\"%s\",\"%s\",%d", type, ip, port);
+	else
+		sprintf(cmd, "AT+CIPSTART=%d,\"%s\",\"%s\",%d", linkID, type, ip, port);
+	if (!sendCommand(cmd, timeout))
+		return CONNECT_ERROR;
+
+	status = waitCommand();
+	_trace.record(TRACE_OP_CONNECT, start);
+	switch (status) {
+		case CMD_OK:
+			return CONNECT_OK;
+		case CMD_TIMEOUT:
+			return CONNECT_TIMEOUT;
+	}
+
+	if (strstr(_buff, "ALREADY CONNECT"))
+		return ALREADY_CONNECT;
+	else
+		return CONNECT_ERROR;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+bool KSM111_ESP8266T<Port, BUFF_LEN, Trace>::isClientConnected()
+{
+	char *ch;
+
+	if (!sendCommand("AT+CIPSTATUS", _defaultTimeout) || waitCommand() != CMD_OK)
+		return false;
+
+	// Get the status ID
+	if ((ch = strstr(_buff, "STATUS:")) == NULL)
+		return false;
+	ch += 7;
+
+	// The status of ID 3 is "Connected".
+	if (*ch == '3')
+		return true;
+	else
+		return false;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+bool KSM111_ESP8266T<Port, BUFF_LEN, Trace>::endClient(int8_t linkID)
+{
+	char cmd[20];
+
+	if (linkID == LINK_SINGLE)
+		strcpy(cmd, "AT+CIPCLOSE");
+	else
+		sprintf(cmd, "AT+CIPCLOSE=%d", linkID);
+
+	/* Response: "[<id>,]CLOSED
+	 *          \nOK"
+	 */
+	if (!sendCommand(cmd, _defaultTimeout))
+		return false;
+	waitCommand();
+
+	if (strstr(_buff, "CLOSED"))
+		return true;
+	else
+		return false;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+void KSM111_ESP8266T<Port, BUFF_LEN, Trace>::getIP(uint8_t mode, char *ip)
+{
+	const char *cmd;
+	char *ch, *secondQoute;
+
+	switch (mode) {
+		case STATION:
+			cmd = "AT+CIPSTA?";
+			break;
+		case AP:
+			cmd = "AT+CIPAP?";
+			break;
+		default:
+			return;
+	}
+
+	if (!sendCommand(cmd, _defaultTimeout) || waitCommand() != CMD_OK)
+		return;
+
+	// Parse IP
+	if ((ch = strchr(_buff, '\"')) != NULL &&
+	    (secondQoute = strchr(ch+1, '\"')) != NULL) {
+		*secondQoute = '\0';
+		strcpy(ip, ch+1);
+	}
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+bool KSM111_ESP8266T<Port, BUFF_LEN, Trace>::beginPassthrough()
+{
+	if (_passthrough)
+		return true;
+
+	if (!sendCommand("AT+CIPMODE=1", _defaultTimeout) || waitCommand() != CMD_OK)
+		return false;
+
+	/* Response: "AT+CIPSEND
+	 *          \nOK
+	 *          \n>"
+	 */
+	if (!sendCommand("AT+CIPSEND", _defaultTimeout, CMD_WAIT_PROMPT) ||
+	    waitCommand() != CMD_OK)
+		return false;
+
+	_passthrough = true;
+	_buffLen = 0;
+	return true;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+bool KSM111_ESP8266T<Port, BUFF_LEN, Trace>::endPassthrough()
+{
+	if (!_passthrough)
+		return true;
+
+	// "+++" must be separated from other data by the guard time.
+	delay(PASSTHROUGH_GUARD_TIME);
+	_serial.print("+++");
+	delay(PASSTHROUGH_GUARD_TIME);
+	_passthrough = false;
+
+	// Drop the data left
+	while (_serial.available())
+		_serial.read();
+
+	return sendCommand("AT+CIPMODE=0", _defaultTimeout) && waitCommand() == CMD_OK;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+bool KSM111_ESP8266T<Port, BUFF_LEN, Trace>::puts(int8_t linkID, const char *msg, unsigned int msgLen)
+{
+	char cmd[24];
+	unsigned long start = _trace.now();
+	bool sent;
+
+	_trace.event(TRACE_BYTES_TX, linkID, msgLen);
+	if (_passthrough) {
+		_serial.write((const uint8_t *)msg, msgLen);
+		_trace.record(TRACE_OP_PUTS, start);
+		return true;
+	}
+
+	if (linkID == LINK_SINGLE)
+		sprintf(cmd, "AT+CIPSEND=%u", msgLen);
+	else
+		sprintf(cmd, "AT+CIPSEND=%d,%u", linkID, msgLen);
+	if (!sendCommand(cmd, _defaultTimeout, CMD_WAIT_PROMPT) ||
+	    waitCommand() != CMD_OK)
+		return false;
+
+	// Send exactly msgLen bytes and wait for "SEND OK" or "ERROR".
+	_serial.write((const uint8_t *)msg, msgLen);
+	expectResponse(_sendTimeout, 0);
+
+	sent = waitCommand() == CMD_OK;
+	_trace.record(TRACE_OP_PUTS, start);
+	return sent;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+int8_t KSM111_ESP8266T<Port, BUFF_LEN, Trace>::gets(char * const msg, unsigned int buffLen,
+                                                    unsigned int *msgLen)
+{
+	if (_passthrough)
+		return getsPassthrough(msg, buffLen, msgLen);
+
+	unsigned long start = _trace.now();
+	uint16_t len;
+	int8_t link;
+
+	// +IPD,<msgLen>:<data> in SINGLE mode
+	// +IPD,<id>,<msgLen>:<data> in MULTIPLE mode
+	receive();
+
+	if ((link = _ipd.pop(msg, buffLen, &len)) < 0)
+		return -1;
+
+	if (msgLen)
+		*msgLen = len;
+	traceReceived(link, len, start);
+	return link;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+int8_t KSM111_ESP8266T<Port, BUFF_LEN, Trace>::gets(int8_t linkID, char * const msg, unsigned int buffLen,
+                                                    unsigned int *msgLen)
+{
+	if (_passthrough)
+		return getsPassthrough(msg, buffLen, msgLen);
+
+	unsigned long start = _trace.now();
+	uint16_t len;
+	int8_t link;
+
+	receive();
+
+	// The frames are stored at link 0 in single connection mode.
+	if ((link = _ipd.pop(linkID == LINK_SINGLE ? 0 : linkID, msg, buffLen, &len)) < 0)
+		return -1;
+
+	if (msgLen)
+		*msgLen = len;
+	traceReceived(link, len, start);
+	return link;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+unsigned int KSM111_ESP8266T<Port, BUFF_LEN, Trace>::read(int8_t linkID, char *buf, unsigned int len)
+{
+	unsigned long start = _trace.now();
+	unsigned int n;
+
+	if (linkID == LINK_SINGLE)
+		linkID = 0;
+
+	if (_passthrough) {
+		// The bytes collected by getsPassthrough() go first.
+		n = _buffLen < len ? _buffLen : len;
+		memcpy(buf, _buff, n);
+		memmove(_buff, _buff + n, _buffLen - n);
+		_buffLen -= n;
+		while (n < len && _serial.available())
+			buf[n++] = _serial.read();
+	} else {
+		receive();
+		n = _ipd.read(linkID, buf, len);
+	}
+
+	if (n != 0)
+		traceReceived(linkID, n, start);
+	return n;
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+void KSM111_ESP8266T<Port, BUFF_LEN, Trace>::traceReceived(int8_t linkID, uint16_t len,
+                                                           unsigned long start)
+{
+	_trace.event(TRACE_BYTES_RX, linkID, len);
+	_trace.record(TRACE_OP_GETS, start);
+}
+
+template <class Port, uint16_t BUFF_LEN, class Trace>
+int8_t KSM111_ESP8266T<Port, BUFF_LEN, Trace>::getsPassthrough(char * const msg, unsigned int buffLen,
+                                                               unsigned int *msgLen)
+{
+	unsigned long start = _trace.now();
+
+	// Collect the bytes until the sender pauses.
+	while (_serial.available() && _buffLen < sizeof(_buff)) {
+		_buff[_buffLen++] = _serial.read();
+		_lastByteTime = millis();
+	}
+
+	if (_buffLen == 0 ||
+	    (_buffLen < sizeof(_buff) && millis() - _lastByteTime < PASSTHROUGH_FRAME_GAP))
+		return -1;
+
+	memset(msg, 0, buffLen);
+	--buffLen;	// 1 for null character
+	memcpy(msg, _buff, _buffLen < buffLen ? _buffLen : buffLen);
+	if (msgLen)
+		*msgLen = _buffLen;
+	traceReceived(0, _buffLen, start);
+	_buffLen = 0;
+
+	return 0;
+}
+
+#endif // _KSM111_ESP8266_IMPL_H_
@@ -0,0 +1,126 @@
+/**
+ * @file KSM111_ESP8266/SerialPort.h
+ * @brief The serial ports which KSM111_ESP8266T communicates with the module through.
+ *
+ * A port provides <tt>begin()</tt>, <tt>end()</tt>, <tt>available()</tt>, <tt>read()</tt>,
+ * <tt>write()</tt>, <tt>print()</tt>, and <tt>println()</tt>.
+ * SoftSerialPort and HardSerialPort call the serial class directly, so there is
+ * no virtual call and no branch on the serial type.
+ */
+#ifndef _SERIAL_PORT_H_
+#define _SERIAL_PORT_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <Stream.h>
+#include <SoftwareSerial.h>
+#include <HardwareSerial.h>
+
+/* Serial type tag */
+enum {HARD, SOFT};
+
+/**
+ * @class SoftSerialPort KSM111_ESP8266/SerialPort.h "SerialPort.h"
+ * @brief The port which owns a <tt>SoftwareSerial</tt>. Nothing is allocated on the heap.
+ */
+class SoftSerialPort
+{
+	public:
+		/**
+		 * @param rxPin The number of pin connected to the TXD pin of the module.
+		 * @param txPin The number of pin connected to the RXD pin of the nodule.
+		 */
+		SoftSerialPort(int rxPin, int txPin) : _serial(rxPin, txPin) {}
+
+		void begin(long baudrate) { _serial.begin(baudrate); }
+		void end() { _serial.end(); }
+		int available() { return _serial.SoftwareSerial::available(); }
+		int read() { return _serial.SoftwareSerial::read(); }
+		size_t write(const uint8_t *data, size_t len)
+		{
+			for (size_t i = 0; i < len; ++i)
+				_serial.SoftwareSerial::write(data[i]);
+			return len;
+		}
+		void print(const char *str) { write((const uint8_t *)str, strlen(str)); }
+		void println(const char *str) { print(str); print("\r\n"); }
+
+	private:
+		SoftwareSerial _serial;
+};
+
+/**
+ * @class HardSerialPort KSM111_ESP8266/SerialPort.h "SerialPort.h"
+ * @brief The port which uses a <tt>HardwareSerial</tt>, for example, <tt>Serial1</tt> of MEGA.
+ */
+class HardSerialPort
+{
+	public:
+		HardSerialPort(HardwareSerial *hws) : _serial(hws) {}
+
+		void begin(long baudrate) { _serial->begin(baudrate); }
+		void end() { _serial->end(); }
+		int available() { return _serial->HardwareSerial::available(); }
+		int read() { return _serial->HardwareSerial::read(); }
+		size_t write(const uint8_t *data, size_t len)
+		{
+			for (size_t i = 0; i < len; ++i)
+				_serial->HardwareSerial::write(data[i]);
+			return len;
+		}
+		void print(const char *str) { write((const uint8_t *)str, strlen(str)); }
+		void println(const char *str) { print(str); print("\r\n"); }
+
+	private:
+		HardwareSerial *_serial;
+};
+
+/**
+ * @class StreamPort KSM111_ESP8266/SerialPort.h "SerialPort.h"
+ * @brief The port which decides the serial type at runtime.
+ *
+ * It keeps the behavior of the original class KSM111_ESP8266:
+ * the <tt>SoftwareSerial</tt> is allocated on the heap, and the I/O goes through <tt>Stream</tt>.
+ * It also accepts any <tt>Stream</tt>, which has no <tt>begin()</tt> and <tt>end()</tt>.
+ */
+class StreamPort
+{
+	public:
+		StreamPort(int rxPin, int txPin)
+			: _serial(new SoftwareSerial(rxPin, txPin)), _serialType(SOFT) {}
+		StreamPort(HardwareSerial *hws) : _serial(hws), _serialType(HARD) {}
+		StreamPort(Stream *stream) : _serial(stream), _serialType(-1) {}
+
+		void begin(long baudrate)
+		{
+			if (_serialType == HARD)
+				((HardwareSerial*)_serial)->begin(baudrate);
+			else if (_serialType == SOFT)
+				((SoftwareSerial*)_serial)->begin(baudrate);
+		}
+		void end()
+		{
+			if (_serialType == HARD)
+				((HardwareSerial*)_serial)->end();
+			else if (_serialType == SOFT)
+				((SoftwareSerial*)_serial)->end();
+		}
+		int available() { return _serial->available(); }
+		int read() { return _serial->read(); }
+		size_t write(const uint8_t *data, size_t len) { return _serial->write(data, len); }
+		void print(const char *str) { _serial->print(str); }
+		void println(const char *str) { _serial->println(str); }
+
+	private:
+		/**
+		 * @brief The interface for communicating with the module.
+		 */
+		Stream *_serial;
+
+		/**
+		 * @brief Record either SoftwareSerial or HarewareSerial is in use.
+		 */
+		int _serialType;
+};
+
+#endif // _SERIAL_PORT_H_
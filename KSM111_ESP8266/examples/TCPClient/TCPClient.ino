@@ -43,7 +43,7 @@ void setup()
 	}
 
 	Serial.print("OK\nJoining to the TCP server... ");
-	if (wifi.beginClient("TCP", TCP_SERVER_IP, TCP_SERVER_PORT) != CONNECT_ERROR)
+	if (wifi.beginClient("TCP", TCP_SERVER_IP, TCP_SERVER_PORT) >= CONNECT_OK)
 		Serial.println("OK");
 	else {
 		// Cannot join to the TCP server, stop.
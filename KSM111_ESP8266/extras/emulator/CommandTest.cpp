@@ -0,0 +1,79 @@
+/*
+ * Run the AT commands of KSM111_ESP8266 back to back against the emulated module.
+ *
+ * Usage: CommandTest
+ *
+ * Each failed check is printed with its line. The exit code is the number of failures.
+ */
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "KSM111_ESP8266.h"
+#include "ESP8266Emulator.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+			++failures; \
+		} \
+	} while (0)
+
+/**
+ * @brief Open a TCP socket on a free port of 127.0.0.1.
+ * @param listening Whether to listen on it. Otherwise, it's closed and the port is left closed.
+ * @return The port, or 0 if failed.
+ */
+static int openTCPPort(bool listening, int *fd)
+{
+	struct sockaddr_in addr;
+	socklen_t addrLen = sizeof(addr);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if ((*fd = socket(AF_INET, SOCK_STREAM, 0)) < 0 ||
+	    bind(*fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    getsockname(*fd, (struct sockaddr *)&addr, &addrLen) != 0 ||
+	    (listening && listen(*fd, 1) != 0))
+		return 0;
+
+	if (!listening)
+		close(*fd);
+	return ntohs(addr.sin_port);
+}
+
+static void testJoinThenConnect()
+{
+	ESP8266Emulator emu;
+	KSM111_ESP8266 wifi(&emu);
+	int fd, closedPort = openTCPPort(false, &fd), port;
+
+	emu.addAP("BRC", "12345678");
+	CHECK(wifi.begin(115200));
+
+	// The "OK" after "WIFI GOT IP" belongs to the join, not to the next command.
+	CHECK(wifi.joinAP("BRC", "12345678") == JAP_OK);
+	CHECK(wifi.beginClient("TCP", "127.0.0.1", closedPort) == CONNECT_ERROR);
+	CHECK(!wifi.isClientConnected());
+
+	CHECK(wifi.joinAP("BRC", "wrong") == ERR_JAP_WRONG_PASSWD);
+	CHECK(wifi.joinAP("BRC", "12345678") == JAP_OK);
+	port = openTCPPort(true, &fd);
+	CHECK(wifi.beginClient("TCP", "127.0.0.1", port) == CONNECT_OK);
+	CHECK(wifi.isClientConnected());
+	CHECK(wifi.endClient());
+	close(fd);
+}
+
+int main()
+{
+	testJoinThenConnect();
+
+	printf("%s: %d failed\n", failures ? "FAIL" : "PASS", failures);
+	return failures;
+}
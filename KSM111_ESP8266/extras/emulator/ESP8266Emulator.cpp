@@ -0,0 +1,556 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "ESP8266Emulator.h"
+
+#define GUARD_TIME_US 1000000ULL	// The silent time around "+++"
+#define PACK_TIME_US    20000ULL	// The passthrough bytes are sent after this idle time
+#define MAX_SEND_LEN 2048
+
+static const char BOOT_MESSAGE[] =
+	"\r\n ets Jan  8 2013,rst cause:2, boot mode:(3,6)\r\n"
+	"\r\nload 0x40100000, len 1856, room 16\r\n"
+	"\r\nready\r\n";
+
+ESP8266Emulator *ESP8266Emulator::_instance = NULL;
+
+static unsigned long long now()
+{
+	return micros();
+}
+
+static bool startsWith(const std::string &str, const char *prefix)
+{
+	return str.compare(0, strlen(prefix), prefix) == 0;
+}
+
+/**
+ * @brief Take the next comma-separated field out of <tt>args</tt> and strip the quotes.
+ */
+static std::string nextField(std::string &args)
+{
+	std::string field;
+	size_t comma = args.find(',');
+
+	field = args.substr(0, comma);
+	args = (comma == std::string::npos) ? "" : args.substr(comma + 1);
+	if (field.size() >= 2 && field[0] == '"' && field[field.size() - 1] == '"')
+		field = field.substr(1, field.size() - 2);
+
+	return field;
+}
+
+ESP8266Emulator::ESP8266Emulator()
+	: _lastDue(0), _baudrate(115200), _inState(IN_COMMAND), _sendLen(0), _sendLink(-1),
+	  _lastInput(0), _chunkGap(0), _echo(true), _mux(false), _passthroughMode(false),
+	  _mode(1), _joined(-1), _hung(false), _inReset(false), _resetPin(-1),
+	  _latency(EMU_LATENCY), _joinTime(EMU_JOIN_TIME), _resetTime(EMU_RESET_TIME),
+	  _dropRate(0), _seed(1),
+	  _commands(0), _droppedBytes(0), _bytesToHost(0), _bytesFromHost(0)
+{
+	for (uint8_t i = 0; i < EMU_MAX_LINKS; ++i)
+		_links[i].fd = -1;
+}
+
+ESP8266Emulator::~ESP8266Emulator()
+{
+	for (uint8_t i = 0; i < EMU_MAX_LINKS; ++i)
+		closeLink(i, false);
+	if (_instance == this) {
+		_instance = NULL;
+		hostPinHook = NULL;
+	}
+}
+
+void ESP8266Emulator::begin(unsigned long baudrate)
+{
+	_baudrate = baudrate;
+}
+
+void ESP8266Emulator::end()
+{
+}
+
+void ESP8266Emulator::addAP(const char *ssid, const char *passwd, int rssi, uint8_t encrypt)
+{
+	AccessPoint ap;
+
+	ap.ssid = ssid;
+	ap.passwd = passwd;
+	ap.rssi = rssi;
+	ap.encrypt = encrypt;
+	_aps.push_back(ap);
+}
+
+void ESP8266Emulator::setDropRate(unsigned int perMille, unsigned int seed)
+{
+	_dropRate = perMille;
+	_seed = seed;
+}
+
+void ESP8266Emulator::mapAddress(const char *ip, const char *hostIP)
+{
+	_addressMap.push_back(std::make_pair(std::string(ip), std::string(hostIP)));
+}
+
+void ESP8266Emulator::setResetPin(uint8_t pin)
+{
+	_resetPin = pin;
+	_instance = this;
+	hostPinHook = pinHook;
+}
+
+void ESP8266Emulator::pinHook(uint8_t pin, uint8_t value)
+{
+	ESP8266Emulator *emu = _instance;
+
+	if (emu == NULL || pin != emu->_resetPin)
+		return;
+
+	if (value == LOW) {
+		emu->reset(true);
+	} else if (emu->_inReset) {
+		emu->_inReset = false;
+		emu->respond(BOOT_MESSAGE, emu->_resetTime);
+	}
+}
+
+void ESP8266Emulator::injectURC(const char *line)
+{
+	respond(std::string(line) + "\r\n");
+}
+
+/* Stream interface */
+
+int ESP8266Emulator::available()
+{
+	int n = 0;
+	unsigned long long t;
+
+	poll();
+	t = now();
+	for (std::deque<Byte>::const_iterator it = _out.begin(); it != _out.end() && it->due <= t; ++it)
+		++n;
+
+	return n;
+}
+
+int ESP8266Emulator::read()
+{
+	char c;
+
+	poll();
+	if (_out.empty() || _out.front().due > now())
+		return -1;
+
+	c = _out.front().c;
+	_out.pop_front();
+	++_bytesToHost;
+
+	return (uint8_t)c;
+}
+
+int ESP8266Emulator::peek()
+{
+	poll();
+	if (_out.empty() || _out.front().due > now())
+		return -1;
+
+	return (uint8_t)_out.front().c;
+}
+
+size_t ESP8266Emulator::write(uint8_t c)
+{
+	unsigned long long t = now();
+	unsigned long long gap = t - _lastInput;
+
+	_lastInput = t;
+	++_bytesFromHost;
+	if (_hung || _inReset)
+		return 1;
+
+	switch (_inState) {
+		case IN_COMMAND:
+			if (c == '\n') {
+				if (!_line.empty() && _line[_line.size() - 1] == '\r')
+					_line.erase(_line.size() - 1);
+				if (_echo)
+					respond(_line + "\r\n");
+				execute(_line);
+				_line.clear();
+			} else {
+				_line += (char)c;
+			}
+			break;
+
+		case IN_SEND_DATA:
+			_sendData += (char)c;
+			if (_sendData.size() == _sendLen) {
+				_inState = IN_COMMAND;
+				reply("\r\nRecv " + std::to_string(_sendLen) + " bytes\r\n");
+				sendToLink(_sendLink, _sendData);
+				_sendData.clear();
+			}
+			break;
+
+		case IN_PASSTHROUGH:
+			if (_sendData.empty())
+				_chunkGap = gap;
+			_sendData += (char)c;
+			break;
+	}
+
+	return 1;
+}
+
+/* Commands */
+
+void ESP8266Emulator::execute(const std::string &cmd)
+{
+	std::string args;
+	std::string status;
+
+	if (cmd.empty())
+		return;
+	++_commands;
+
+	if (cmd == "AT") {
+		reply("\r\nOK\r\n");
+	} else if (cmd == "ATE0" || cmd == "ATE1") {
+		_echo = (cmd == "ATE1");
+		reply("\r\nOK\r\n");
+	} else if (cmd == "AT+RST") {
+		reply("\r\nOK\r\n");
+		reset(false);
+	} else if (startsWith(cmd, "AT+CWMODE=")) {
+		_mode = atoi(cmd.c_str() + 10);
+		reply("\r\nOK\r\n");
+	} else if (cmd == "AT+CWMODE?") {
+		reply("+CWMODE:" + std::to_string(_mode) + "\r\n\r\nOK\r\n");
+	} else if (cmd == "AT+CWJAP?") {
+		if (_joined < 0)
+			reply("No AP\r\n\r\nOK\r\n");
+		else
+			reply("+CWJAP:\"" + _aps[_joined].ssid + "\",\"aa:bb:cc:dd:ee:ff\",1," +
+			      std::to_string(_aps[_joined].rssi) + "\r\n\r\nOK\r\n");
+	} else if (startsWith(cmd, "AT+CWJAP=")) {
+		executeCWJAP(cmd.substr(9));
+	} else if (cmd == "AT+CWQAP") {
+		for (uint8_t i = 0; i < EMU_MAX_LINKS; ++i)
+			closeLink(i, true);
+		reply("\r\nOK\r\n");
+		if (_joined >= 0)
+			reply("WIFI DISCONNECT\r\n");
+		_joined = -1;
+	} else if (cmd == "AT+CWLAP") {
+		std::string list;
+
+		for (size_t i = 0; i < _aps.size(); ++i)
+			list += "+CWLAP:(" + std::to_string(_aps[i].encrypt) + ",\"" + _aps[i].ssid + "\"," +
+			        std::to_string(_aps[i].rssi) + ",\"aa:bb:cc:dd:ee:0" + std::to_string(i % 10) +
+			        "\"," + std::to_string(i % 13 + 1) + ")\r\n";
+		reply(list + "\r\nOK\r\n");
+	} else if (startsWith(cmd, "AT+CIPMUX=")) {
+		bool open = false;
+
+		for (uint8_t i = 0; i < EMU_MAX_LINKS; ++i)
+			open = open || _links[i].fd >= 0;
+		if (open) {
+			reply("link is builded\r\n\r\nERROR\r\n");
+		} else {
+			_mux = (cmd[10] == '1');
+			reply("\r\nOK\r\n");
+		}
+	} else if (startsWith(cmd, "AT+CIPMODE=")) {
+		if (cmd[11] == '1' && _mux) {
+			reply("\r\nERROR\r\n");
+		} else {
+			_passthroughMode = (cmd[11] == '1');
+			reply("\r\nOK\r\n");
+		}
+	} else if (startsWith(cmd, "AT+CIPSTART=")) {
+		executeCIPSTART(cmd.substr(12));
+	} else if (cmd == "AT+CIPSEND") {
+		if (!_passthroughMode || _mux || _links[0].fd < 0) {
+			reply("\r\nERROR\r\n");
+		} else {
+			_inState = IN_PASSTHROUGH;
+			_sendData.clear();
+			reply("\r\nOK\r\n\r\n>");
+		}
+	} else if (startsWith(cmd, "AT+CIPSEND=")) {
+		executeCIPSEND(cmd.substr(11));
+	} else if (cmd == "AT+CIPCLOSE" || startsWith(cmd, "AT+CIPCLOSE=")) {
+		executeCIPCLOSE(cmd.size() > 11 ? cmd.substr(12) : "");
+	} else if (cmd == "AT+CIPSTATUS") {
+		status = "STATUS:" + std::string(_joined < 0 ? "5" : "2");
+		for (uint8_t i = 0; i < EMU_MAX_LINKS; ++i) {
+			if (_links[i].fd < 0)
+				continue;
+			status[7] = '3';
+			status += "\r\n+CIPSTATUS:" + std::to_string(i) + ",\"" + _links[i].type + "\",\"" +
+			          _links[i].ip + "\"," + std::to_string(_links[i].port) + ",0,0";
+		}
+		reply(status + "\r\n\r\nOK\r\n");
+	} else if (cmd == "AT+CIPSTA?") {
+		reply(std::string("+CIPSTA:ip:\"") + (_joined < 0 ? "0.0.0.0" : "192.168.1.50") +
+		      "\"\r\n\r\nOK\r\n");
+	} else if (cmd == "AT+CIPAP?") {
+		reply("+CIPAP:ip:\"192.168.4.1\"\r\n\r\nOK\r\n");
+	} else if (startsWith(cmd, "AT+CIOBAUD=")) {
+		// The response is sent in the old baudrate.
+		reply("\r\nOK\r\n");
+		_baudrate = strtoul(cmd.c_str() + 11, NULL, 10);
+	} else {
+		reply("\r\nERROR\r\n");
+	}
+}
+
+void ESP8266Emulator::executeCWJAP(const std::string &args)
+{
+	std::string rest = args;
+	std::string ssid = nextField(rest);
+	std::string passwd = nextField(rest);
+	std::string prefix;
+
+	if (_joined >= 0)
+		prefix = "WIFI DISCONNECT\r\n";
+	_joined = -1;
+	for (size_t i = 0; i < _aps.size(); ++i) {
+		if (_aps[i].ssid != ssid)
+			continue;
+		if (_aps[i].passwd != passwd) {
+			respond(prefix + "+CWJAP:2\r\n\r\nFAIL\r\n", _joinTime);
+		} else {
+			_joined = i;
+			respond(prefix + "WIFI CONNECTED\r\nWIFI GOT IP\r\n\r\nOK\r\n", _joinTime);
+		}
+		return;
+	}
+
+	respond(prefix + "+CWJAP:3\r\n\r\nFAIL\r\n", _joinTime);
+}
+
+void ESP8266Emulator::executeCIPSTART(const std::string &args)
+{
+	std::string rest = args;
+	int id = _mux ? atoi(nextField(rest).c_str()) : 0;
+	std::string type = nextField(rest);
+	std::string ip = nextField(rest);
+	int port = atoi(nextField(rest).c_str());
+	std::string hostIP = ip;
+	struct sockaddr_in addr;
+	Link &link = _links[id < EMU_MAX_LINKS && id >= 0 ? id : 0];
+	int fd;
+
+	if (id < 0 || id >= EMU_MAX_LINKS || (type != "TCP" && type != "UDP")) {
+		reply("\r\nERROR\r\n");
+		return;
+	}
+	if (_joined < 0) {
+		reply("no ip\r\n\r\nERROR\r\n");
+		return;
+	}
+	if (link.fd >= 0) {
+		reply("ALREADY CONNECTED\r\n\r\nERROR\r\n");
+		return;
+	}
+
+	for (size_t i = 0; i < _addressMap.size(); ++i) {
+		if (_addressMap[i].first == ip)
+			hostIP = _addressMap[i].second;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	fd = socket(AF_INET, type == "UDP" ? SOCK_DGRAM : SOCK_STREAM, 0);
+	if (fd < 0 || inet_pton(AF_INET, hostIP.c_str(), &addr.sin_addr) != 1 ||
+	    connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		if (fd >= 0)
+			close(fd);
+		reply("\r\nERROR\r\n" + linkPrefix(id) + "CLOSED\r\n");
+		return;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	link.fd = fd;
+	link.udp = (type == "UDP");
+	link.type = type;
+	link.ip = ip;
+	link.port = port;
+	reply(linkPrefix(id) + "CONNECT\r\n\r\nOK\r\n");
+}
+
+void ESP8266Emulator::executeCIPSEND(const std::string &args)
+{
+	std::string rest = args;
+	int id = _mux ? atoi(nextField(rest).c_str()) : 0;
+	long len = atol(nextField(rest).c_str());
+
+	if ((!_mux && args.find(',') != std::string::npos) ||
+	    id < 0 || id >= EMU_MAX_LINKS || len <= 0 || len > MAX_SEND_LEN) {
+		reply("\r\nERROR\r\n");
+		return;
+	}
+	if (_links[id].fd < 0) {
+		reply("link is not valid\r\n\r\nERROR\r\n");
+		return;
+	}
+
+	_inState = IN_SEND_DATA;
+	_sendLink = id;
+	_sendLen = len;
+	_sendData.clear();
+	reply("\r\nOK\r\n> ");
+}
+
+void ESP8266Emulator::executeCIPCLOSE(const std::string &args)
+{
+	int id = args.empty() ? 0 : atoi(args.c_str());
+
+	if ((args.empty() && _mux) || (!args.empty() && !_mux)) {
+		reply("\r\nERROR\r\n");
+		return;
+	}
+
+	if (id == EMU_MAX_LINKS) {	// Close all the links
+		for (uint8_t i = 0; i < EMU_MAX_LINKS; ++i)
+			closeLink(i, true);
+		reply("\r\nOK\r\n");
+		return;
+	}
+
+	if (id < 0 || id > EMU_MAX_LINKS || _links[id].fd < 0) {
+		reply("UNLINK\r\n\r\nERROR\r\n");
+		return;
+	}
+
+	closeLink(id, true);
+	reply("\r\nOK\r\n");
+}
+
+/* Internal */
+
+void ESP8266Emulator::respond(const std::string &str, unsigned long delay)
+{
+	unsigned long long due = now() + delay * 1000ULL;
+	unsigned long long base;
+	Byte b;
+
+	if (due < _lastDue)
+		due = _lastDue;
+	base = due;
+
+	for (size_t i = 0; i < str.size(); ++i) {
+		if (_baudrate != 0)
+			due = base + (i + 1) * 10000000ULL / _baudrate;	// 10 bits per byte
+		if (_dropRate != 0 && (unsigned int)(rand_r(&_seed) % 1000) < _dropRate) {
+			++_droppedBytes;
+			continue;
+		}
+		b.c = str[i];
+		b.due = due;
+		_out.push_back(b);
+	}
+	_lastDue = due;
+}
+
+void ESP8266Emulator::poll()
+{
+	char buf[MAX_SEND_LEN];
+	unsigned long long t = now();
+	ssize_t n;
+
+	if (_inReset)
+		return;
+
+	// Send the passthrough bytes, or leave the passthrough mode by "+++".
+	if (_inState == IN_PASSTHROUGH && !_sendData.empty() && t - _lastInput >= PACK_TIME_US) {
+		if (_sendData == "+++" && _chunkGap >= GUARD_TIME_US) {
+			if (t - _lastInput >= GUARD_TIME_US) {
+				_inState = IN_COMMAND;
+				_sendData.clear();
+			}
+		} else {
+			sendToLink(0, _sendData);
+			_sendData.clear();
+		}
+	}
+
+	if (_hung)
+		return;
+
+	for (uint8_t i = 0; i < EMU_MAX_LINKS; ++i) {
+		if (_links[i].fd < 0)
+			continue;
+
+		n = recv(_links[i].fd, buf, sizeof(buf), 0);
+		if (n > 0) {
+			if (_inState == IN_PASSTHROUGH)
+				respond(std::string(buf, n));
+			else
+				respond("\r\n+IPD," + (_mux ? std::to_string(i) + "," : std::string()) +
+				        std::to_string(n) + ":" + std::string(buf, n));
+		} else if (n == 0 && !_links[i].udp) {
+			closeLink(i, true);
+		} else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+			closeLink(i, true);
+		}
+	}
+}
+
+void ESP8266Emulator::sendToLink(int8_t link, const std::string &data)
+{
+	bool ok = link >= 0 && link < EMU_MAX_LINKS && _links[link].fd >= 0 &&
+	          send(_links[link].fd, data.data(), data.size(), MSG_NOSIGNAL) == (ssize_t)data.size();
+
+	if (_inState != IN_PASSTHROUGH)
+		reply(ok ? "\r\nSEND OK\r\n" : "\r\nSEND FAIL\r\n");
+}
+
+void ESP8266Emulator::closeLink(uint8_t link, bool report)
+{
+	if (_links[link].fd < 0)
+		return;
+
+	close(_links[link].fd);
+	_links[link].fd = -1;
+	if (_inState == IN_PASSTHROUGH && link == 0)
+		_inState = IN_COMMAND;
+	if (report)
+		respond(linkPrefix(link) + "CLOSED\r\n");
+}
+
+void ESP8266Emulator::reset(bool byPin)
+{
+	for (uint8_t i = 0; i < EMU_MAX_LINKS; ++i)
+		closeLink(i, false);
+
+	_inState = IN_COMMAND;
+	_line.clear();
+	_sendData.clear();
+	_mux = false;
+	_passthroughMode = false;
+	_echo = true;
+	_joined = -1;
+	_hung = false;
+
+	if (byPin) {
+		// Held in reset until the pin goes HIGH
+		_out.clear();
+		_lastDue = 0;
+		_inReset = true;
+	} else {
+		respond(BOOT_MESSAGE, _resetTime);
+	}
+}
+
+std::string ESP8266Emulator::linkPrefix(uint8_t link) const
+{
+	return _mux ? std::to_string(link) + "," : std::string();
+}
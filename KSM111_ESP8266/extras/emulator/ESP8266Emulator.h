@@ -0,0 +1,213 @@
+/**
+ * @file ESP8266Emulator.h
+ * @brief The header file of class ESP8266Emulator.
+ */
+#ifndef _ESP8266_EMULATOR_H_
+#define _ESP8266_EMULATOR_H_
+
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+
+/* The default timing of the emulated module in milliseconds */
+#define EMU_LATENCY     2	// From receiving a command to the first byte of the response
+#define EMU_JOIN_TIME 500	// AT+CWJAP
+#define EMU_RESET_TIME 300	// From AT+RST or the RST pin to "ready"
+
+#define EMU_MAX_LINKS 5
+
+/**
+ * @class ESP8266Emulator ESP8266Emulator.h "ESP8266Emulator.h"
+ * @brief The AT firmware of the ESP8266 module emulated on the host.
+ *
+ * It's a <tt>HardwareSerial</tt>, so it can be passed to the constructors of
+ * KSM111_ESP8266 and BRCClient. The bytes written to it are parsed as AT commands,
+ * and the responses are read back at the speed of the baudrate given to <tt>begin()</tt>.
+ *
+ * The connections opened by AT+CIPSTART are real sockets of the host,
+ * so the library can talk to a server on the developer machine.
+ *
+ * Supported commands: AT, ATE0/ATE1, AT+RST, AT+CWMODE, AT+CWJAP, AT+CWQAP, AT+CWLAP,
+ * AT+CIPMUX, AT+CIPMODE, AT+CIPSTART, AT+CIPSEND, AT+CIPCLOSE, AT+CIPSTATUS,
+ * AT+CIPSTA?, AT+CIPAP?, and AT+CIOBAUD. The others are answered with "ERROR".
+ */
+class ESP8266Emulator : public HardwareSerial
+{
+	public:
+		ESP8266Emulator();
+		~ESP8266Emulator();
+
+		/**
+		 * @brief Set the baudrate of the emulated UART.
+		 *
+		 * The module sends a byte every 10 bits. 0 to send the bytes without delay.
+		 */
+		void begin(unsigned long baudrate);
+		void end();
+
+		/**
+		 * @name Stream interface
+		 * The interface used by the driver.
+		 */
+		/** @{ */
+		int available();
+		int read();
+		int peek();
+		size_t write(uint8_t c);
+		using Print::write;
+		/** @} */
+
+		/**
+		 * @name Configuration
+		 */
+		/** @{ */
+		/**
+		 * @brief Add an access point which can be listed and joined.
+		 */
+		void addAP(const char *ssid, const char *passwd, int rssi = -50, uint8_t encrypt = 3);
+		/**
+		 * @brief Set the delay before the response of each command in milliseconds.
+		 */
+		void setLatency(unsigned long ms) { _latency = ms; }
+		/**
+		 * @brief Set the time of joining an AP in milliseconds.
+		 */
+		void setJoinTime(unsigned long ms) { _joinTime = ms; }
+		/**
+		 * @brief Set the time of restarting in milliseconds.
+		 */
+		void setResetTime(unsigned long ms) { _resetTime = ms; }
+		/**
+		 * @brief Drop the bytes sent to the driver at random.
+		 * @param perMille The probability of dropping a byte in 1/1000.
+		 * @param seed The seed of the random numbers, for repeating a run.
+		 */
+		void setDropRate(unsigned int perMille, unsigned int seed = 1);
+		/**
+		 * @brief Connect the address used in AT+CIPSTART to another host address.
+		 *
+		 * For example, map the address of the BRC server to "127.0.0.1".
+		 */
+		void mapAddress(const char *ip, const char *hostIP);
+		/**
+		 * @brief Emulate the RST pin. Driving it LOW holds the module in reset.
+		 */
+		void setResetPin(uint8_t pin);
+		/** @} */
+
+		/**
+		 * @brief Send an unsolicited line to the driver, for example, "WIFI DISCONNECT".
+		 *
+		 * "\r\n" is appended. It's sent after the bytes already queued.
+		 */
+		void injectURC(const char *line);
+
+		/**
+		 * @brief Emulate a hang: stop answering until a reset.
+		 */
+		void hang() { _hung = true; }
+
+		/**
+		 * @name Statistics
+		 */
+		/** @{ */
+		unsigned long commands() const { return _commands; }
+		unsigned long droppedBytes() const { return _droppedBytes; }
+		unsigned long bytesToHost() const { return _bytesToHost; }
+		unsigned long bytesFromHost() const { return _bytesFromHost; }
+		/** @} */
+
+	private:
+		struct AccessPoint {
+			std::string ssid;
+			std::string passwd;
+			int rssi;
+			uint8_t encrypt;
+		};
+
+		struct Link {
+			int  fd;	///< The socket, -1 if it's closed
+			bool udp;
+			std::string type;
+			std::string ip;
+			int  port;
+		};
+
+		struct Byte {
+			char c;
+			unsigned long long due;	///< micros() when it can be read
+		};
+
+		/* The receiving state of the bytes written by the driver */
+		enum { IN_COMMAND, IN_SEND_DATA, IN_PASSTHROUGH };
+
+		void execute(const std::string &cmd);
+		void executeCIPSTART(const std::string &args);
+		void executeCIPSEND(const std::string &args);
+		void executeCIPCLOSE(const std::string &args);
+		void executeCWJAP(const std::string &args);
+
+		/**
+		 * @brief Queue the bytes to the driver after <tt>delay</tt> milliseconds from now.
+		 *
+		 * The bytes are sent after the bytes already queued.
+		 */
+		void respond(const std::string &str, unsigned long delay = 0);
+		/**
+		 * @brief Queue the response of a command after the latency.
+		 */
+		void reply(const std::string &str) { respond(str, _latency); }
+
+		/**
+		 * @brief Receive from the sockets, and run the delayed events.
+		 */
+		void poll();
+		void sendToLink(int8_t link, const std::string &data);
+		void closeLink(uint8_t link, bool report);
+		void reset(bool byPin);
+		std::string linkPrefix(uint8_t link) const;
+
+		static void pinHook(uint8_t pin, uint8_t value);
+		static ESP8266Emulator *_instance;
+
+		std::deque<Byte> _out;
+		unsigned long long _lastDue;	///< The due time of the last queued byte
+		unsigned long _baudrate;
+
+		int _inState;
+		std::string _line;
+		std::string _sendData;
+		size_t _sendLen;
+		int8_t _sendLink;
+		unsigned long long _lastInput;	///< micros() of the last byte written by the driver
+		unsigned long long _chunkGap;	///< The silent time before the pending passthrough bytes
+
+		bool _echo;
+		bool _mux;
+		bool _passthroughMode;
+		uint8_t _mode;
+		int _joined;	///< The index of the joined AP, -1 if none
+		bool _hung;
+		bool _inReset;
+		int _resetPin;
+		Link _links[EMU_MAX_LINKS];
+
+		std::vector<AccessPoint> _aps;
+		std::vector<std::pair<std::string, std::string> > _addressMap;
+
+		unsigned long _latency;
+		unsigned long _joinTime;
+		unsigned long _resetTime;
+		unsigned int _dropRate;
+		unsigned int _seed;
+
+		unsigned long _commands;
+		unsigned long _droppedBytes;
+		unsigned long _bytesToHost;
+		unsigned long _bytesFromHost;
+};
+
+#endif // _ESP8266_EMULATOR_H_
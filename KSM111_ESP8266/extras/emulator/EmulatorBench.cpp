@@ -0,0 +1,115 @@
+/*
+ * Time KSM111_ESP8266 against the emulated module and a TCP server on the host.
+ *
+ * Usage: EmulatorBench [port [count [baudrate [dropPerMille]]]]
+ *
+ * The messages are sent to 127.0.0.1:<port> and the replies are read back.
+ * If <port> is 0 or missing, an echo server is started on a free port.
+ */
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "KSM111_ESP8266.h"
+#include "ESP8266Emulator.h"
+
+#define RESET_PIN 4
+
+typedef KSM111_ESP8266T<StreamPort, 128, CommandTrace<32> > TracedESP8266;
+
+/**
+ * @brief Fork an echo server on a free port of 127.0.0.1.
+ * @return The port, or 0 if failed.
+ */
+static int startEchoServer(pid_t *pid)
+{
+	struct sockaddr_in addr;
+	socklen_t addrLen = sizeof(addr);
+	char buf[2048];
+	int fd, conn;
+	ssize_t n;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0 ||
+	    bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    listen(fd, 4) != 0 ||
+	    getsockname(fd, (struct sockaddr *)&addr, &addrLen) != 0)
+		return 0;
+
+	if ((*pid = fork()) != 0) {
+		close(fd);
+		return *pid > 0 ? ntohs(addr.sin_port) : 0;
+	}
+
+	while ((conn = accept(fd, NULL, NULL)) >= 0) {
+		while ((n = recv(conn, buf, sizeof(buf), 0)) > 0)
+			send(conn, buf, n, MSG_NOSIGNAL);
+		close(conn);
+	}
+	_exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+	int port = argc > 1 ? atoi(argv[1]) : 0;
+	int count = argc > 2 ? atoi(argv[2]) : 100;
+	unsigned long baudrate = argc > 3 ? strtoul(argv[3], NULL, 10) : 115200;
+	unsigned int drop = argc > 4 ? atoi(argv[4]) : 0;
+	pid_t server = 0;
+	ESP8266Emulator emu;
+	TracedESP8266 wifi(&emu, RESET_PIN);
+	char msg[64], reply[64];
+	unsigned long start, elapsed;
+	int sent = 0, received = 0;
+
+	if (port == 0 && (port = startEchoServer(&server)) == 0) {
+		fprintf(stderr, "Cannot start the echo server\n");
+		return 1;
+	}
+
+	emu.addAP("BRC", "12345678");
+	emu.setResetPin(RESET_PIN);
+	emu.setDropRate(drop);
+
+	if (!wifi.begin(baudrate) || !wifi.hardReset() ||
+	    wifi.joinAP("BRC", "12345678") != JAP_OK ||
+	    wifi.beginClient("TCP", "127.0.0.1", port) < CONNECT_OK) {
+		fprintf(stderr, "Cannot connect to 127.0.0.1:%d\n", port);
+		return 1;
+	}
+
+	start = millis();
+	for (int i = 0; i < count; ++i) {
+		sprintf(msg, "message %d", i);
+		if (wifi.puts(msg))
+			++sent;
+
+		// Wait for the echo up to 100 ms
+		for (unsigned long t = millis(); millis() - t < 100; ) {
+			if (wifi.gets(reply, sizeof(reply)) != -1) {
+				if (strcmp(msg, reply) == 0)
+					++received;
+				break;
+			}
+		}
+	}
+	elapsed = millis() - start;
+
+	wifi.endClient();
+	if (server > 0) {
+		kill(server, SIGTERM);
+		waitpid(server, NULL, 0);
+	}
+
+	printf("%d sent, %d echoed in %lu ms at %lu baud, %lu bytes dropped\n",
+	       sent, received, elapsed, baudrate, emu.droppedBytes());
+	printf("L <op> <count> <min us> <avg us> <max us> <buckets of 1, 4, 16, 64, 256, 1024, 4096, more ms>\n");
+	wifi.trace().dump(Serial);
+
+	return received == count ? 0 : 2;
+}
@@ -0,0 +1,70 @@
+/*
+ * Time IPDParser on the host.
+ *
+ * Usage: IPDParserBench [rounds [dataLen]]
+ *
+ * A stream of +IPD frames of <dataLen> bytes on 2 links, with a URC line after
+ * every 8 frames, is fed <rounds> times. The frames are popped as they complete.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "IPDParser.h"
+
+#define STREAM_FRAMES 256
+
+static double nowUs()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+int main(int argc, char *argv[])
+{
+	int rounds = argc > 1 ? atoi(argv[1]) : 1000;
+	int dataLen = argc > 2 ? atoi(argv[2]) : 36;	// A v2 frame of a full CommMsg
+	static char stream[STREAM_FRAMES * 64];
+	char msg[64];
+	unsigned int len = 0;
+	unsigned long frames = 0, passed = 0, sum = 0;
+	double start, elapsed;
+	IPDParser parser;
+
+	if (dataLen < 1 || dataLen > 40) {
+		fprintf(stderr, "dataLen must be 1 to 40\n");
+		return 1;
+	}
+
+	for (int i = 0; i < STREAM_FRAMES; ++i) {
+		len += sprintf(stream + len, "\r\n+IPD,%d,%d:", i & 1, dataLen);
+		for (int j = 0; j < dataLen; ++j)
+			stream[len++] = (char)(i + j);
+		if (i % 8 == 7)
+			len += sprintf(stream + len, "\r\n0,CLOSED");
+	}
+
+	start = nowUs();
+	for (int r = 0; r < rounds; ++r) {
+		for (unsigned int i = 0; i < len; ++i) {
+			passed += parser.feed(stream[i]);
+			if (parser.available() != 0 && parser.pop(msg, sizeof(msg)) >= 0) {
+				++frames;
+				sum += (uint8_t)msg[0];	// Keep the pop from being optimized out
+			}
+		}
+	}
+	elapsed = nowUs() - start;
+
+	printf("%lu frames, %lu bytes passed, %lu dropped, %lu malformed (checksum %lu)\n",
+	       frames, passed, (unsigned long)parser.droppedFrames(),
+	       (unsigned long)parser.malformedFrames(), sum);
+	printf("%.1f ns/byte, %.1f ns/frame, %.1f MB/s\n",
+	       elapsed * 1e3 / ((double)len * rounds), elapsed * 1e3 / frames,
+	       (double)len * rounds / elapsed);
+
+	return frames == (unsigned long)STREAM_FRAMES * rounds ? 0 : 2;
+}
@@ -0,0 +1,334 @@
+/*
+ * Feed IPDParser the +IPD streams seen from the module, and the broken ones.
+ *
+ * Usage: IPDParserTest
+ *
+ * Each failed check is printed with its line. The exit code is the number of failures.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "IPDParser.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+			++failures; \
+		} \
+	} while (0)
+
+/**
+ * @brief The bytes passed back by the parser.
+ */
+static char passed[256];
+static unsigned int passedLen;
+
+/**
+ * @brief Feed <tt>len</tt> bytes, and append the passed bytes to <tt>passed</tt>.
+ */
+static void feed(IPDParser *parser, const char *data, unsigned int len)
+{
+	uint8_t n;
+
+	while (len--) {
+		n = parser->feed(*data++);
+		if (passedLen + n < sizeof(passed)) {
+			memcpy(passed + passedLen, parser->passed(), n);
+			passedLen += n;
+		}
+	}
+	passed[passedLen] = '\0';
+}
+
+static void feed(IPDParser *parser, const char *str)
+{
+	feed(parser, str, strlen(str));
+}
+
+static void begin(IPDParser *parser)
+{
+	parser->reset();
+	passedLen = 0;
+	passed[0] = '\0';
+}
+
+/**
+ * @brief Pop the next frame and compare it with <tt>data</tt>.
+ */
+static bool popEquals(IPDParser *parser, int8_t link, const char *data, unsigned int len)
+{
+	char msg[64];
+
+	if (parser->pop(msg, sizeof(msg)) != link)
+		return false;
+	return memcmp(msg, data, len) == 0 && msg[len] == '\0';
+}
+
+static bool popEquals(IPDParser *parser, int8_t link, const char *str)
+{
+	return popEquals(parser, link, str, strlen(str));
+}
+
+static void testSplitFrame()
+{
+	IPDParser parser;
+	const char *stream = "\r\n+IPD,0,11:hello world";
+	unsigned int len = strlen(stream);
+	char msg[16];
+
+	// Split at every position, the frame only completes with its last byte.
+	for (unsigned int cut = 1; cut < len; ++cut) {
+		begin(&parser);
+		feed(&parser, stream, cut);
+		CHECK(parser.available() == 0);
+		CHECK(parser.pop(msg, sizeof(msg)) == -1);
+		feed(&parser, stream + cut, len - cut);
+		CHECK(parser.available() == 1);
+		CHECK(popEquals(&parser, 0, "hello world"));
+		CHECK(strcmp(passed, "\r\n") == 0);
+	}
+
+	// Single connection mode, one byte at a time.
+	begin(&parser);
+	feed(&parser, "+IPD,");
+	feed(&parser, "4");
+	feed(&parser, ":");
+	feed(&parser, "ab");
+	CHECK(parser.available() == 0);
+	feed(&parser, "cd");
+	CHECK(popEquals(&parser, 0, "abcd"));
+}
+
+static void testBurst()
+{
+	IPDParser parser;
+
+	// Two frames back to back, as the module sends a burst.
+	begin(&parser);
+	feed(&parser, "+IPD,0,3:abc\r\n+IPD,1,2:de+IPD,0,1:f");
+	CHECK(parser.available() == 3);
+	CHECK(parser.available(0) == 2);
+	CHECK(parser.available(1) == 1);
+	CHECK(popEquals(&parser, 0, "abc"));
+	CHECK(popEquals(&parser, 0, "f"));
+	CHECK(popEquals(&parser, 1, "de"));
+	CHECK(parser.available() == 0);
+	CHECK(strcmp(passed, "\r\n") == 0);
+
+	// The data is binary: null characters, newlines, and "+IPD," in it.
+	begin(&parser);
+	feed(&parser, "+IPD,0,9:\0\n+IPD,\xA5\n", 18);
+	CHECK(popEquals(&parser, 0, "\0\n+IPD,\xA5\n", 9));
+	CHECK(passedLen == 0);
+
+	// Zero length frame.
+	begin(&parser);
+	feed(&parser, "+IPD,0,0:+IPD,0,1:x");
+	CHECK(popEquals(&parser, 0, ""));
+	CHECK(popEquals(&parser, 0, "x"));
+}
+
+static void testBadLength()
+{
+	IPDParser parser;
+
+	// Not a number
+	begin(&parser);
+	feed(&parser, "+IPD,0,x:abc\r\n+IPD,0,2:ok");
+	CHECK(parser.malformedFrames() == 1);
+	CHECK(popEquals(&parser, 0, "ok"));
+
+	// No digits
+	begin(&parser);
+	feed(&parser, "+IPD,0,:\r\n+IPD,:\r\n+IPD,0,2:ok");
+	CHECK(parser.malformedFrames() == 2);
+	CHECK(popEquals(&parser, 0, "ok"));
+
+	// Longer than the module can send
+	begin(&parser);
+	feed(&parser, "+IPD,0,99999:abc\r\n+IPD,0,2:ok");
+	CHECK(parser.malformedFrames() == 1);
+	CHECK(parser.available() == 1);
+	CHECK(popEquals(&parser, 0, "ok"));
+
+	// Longer than the ring buffer: the data is consumed and dropped.
+	char header[16], data[IPD_RING_SIZE];
+	memset(data, 'z', sizeof(data));
+	begin(&parser);
+	sprintf(header, "+IPD,0,%d:", IPD_RING_SIZE);
+	feed(&parser, header);
+	feed(&parser, data, sizeof(data));
+	feed(&parser, "\r\n+IPD,0,2:ok");
+	CHECK(parser.droppedFrames() == 1);
+	CHECK(parser.available() == 1);
+	CHECK(popEquals(&parser, 0, "ok"));
+	CHECK(strcmp(passed, "\r\n") == 0);
+
+	// Link ID with 2 digits
+	begin(&parser);
+	feed(&parser, "+IPD,12,2:no\r\n+IPD,0,2:ok");
+	CHECK(parser.malformedFrames() == 1);
+	CHECK(popEquals(&parser, 0, "ok"));
+}
+
+static void testMissingColon()
+{
+	IPDParser parser;
+
+	// The header is dropped, and the rest of the line is passed back.
+	begin(&parser);
+	feed(&parser, "+IPD,0,5hello\r\n+IPD,0,2:ok");
+	CHECK(parser.malformedFrames() == 1);
+	CHECK(parser.available() == 1);
+	CHECK(popEquals(&parser, 0, "ok"));
+	CHECK(strcmp(passed, "ello\r\n") == 0);
+
+	// The line ends in the header.
+	begin(&parser);
+	feed(&parser, "+IPD,0,5\r\n+IPD,0,2:ok");
+	CHECK(parser.malformedFrames() == 1);
+	CHECK(popEquals(&parser, 0, "ok"));
+}
+
+static void testURC()
+{
+	IPDParser parser;
+
+	// The unsolicited result codes between and right after the frames are passed back.
+	begin(&parser);
+	feed(&parser, "+IPD,0,2:ab\r\n0,CLOSED\r\nWIFI DISCONNECT\r\n+IPD,1,2:cdSEND OK\r\n");
+	CHECK(popEquals(&parser, 0, "ab"));
+	CHECK(popEquals(&parser, 1, "cd"));
+	CHECK(strcmp(passed, "\r\n0,CLOSED\r\nWIFI DISCONNECT\r\nSEND OK\r\n") == 0);
+
+	// The lines looking like the prefix are passed back as they are.
+	begin(&parser);
+	feed(&parser, "+IP\r\n+CIFSR:STAIP\r\n+IPX\r\nbusy p...\r\n");
+	CHECK(parser.available() == 0);
+	CHECK(parser.malformedFrames() == 0);
+	CHECK(strcmp(passed, "+IP\r\n+CIFSR:STAIP\r\n+IPX\r\nbusy p...\r\n") == 0);
+
+	// "+IPD," is only a frame at the beginning of a line.
+	begin(&parser);
+	feed(&parser, "OK +IPD,0,2:ab\r\n");
+	CHECK(parser.available() == 0);
+	CHECK(strcmp(passed, "OK +IPD,0,2:ab\r\n") == 0);
+}
+
+static void testOverflow()
+{
+	IPDParser parser;
+	char frame[32];
+	int n = 0;
+
+	// Fill the ring of link 0 with 10-byte frames, 12 bytes each in the ring.
+	begin(&parser);
+	while (parser.droppedFrames() == 0) {
+		sprintf(frame, "+IPD,0,10:frame%05d", n++);
+		feed(&parser, frame);
+	}
+	CHECK(parser.available(0) == IPD_RING_SIZE / 12);
+	CHECK(n - 1 == IPD_RING_SIZE / 12);
+
+	// The other links have their own rings.
+	feed(&parser, "+IPD,1,2:ok");
+	CHECK(parser.available(1) == 1);
+
+	// The links out of range are dropped.
+	feed(&parser, "+IPD,4,2:no");
+	CHECK(parser.droppedFrames() == 2);
+
+	// The frames kept are in order, and the ring takes frames again after popping one.
+	CHECK(popEquals(&parser, 0, "frame00000"));
+	feed(&parser, "+IPD,0,10:frame99999");
+	CHECK(parser.droppedFrames() == 2);
+	for (int i = 1; i < n - 1; ++i) {
+		sprintf(frame, "frame%05d", i);
+		CHECK(popEquals(&parser, 0, frame));
+	}
+	CHECK(popEquals(&parser, 0, "frame99999"));
+	CHECK(popEquals(&parser, 1, "ok"));
+	CHECK(parser.available() == 0);
+	CHECK(passedLen == 0);
+
+	// The data longer than the buffer of pop() is truncated, and its length is still reported.
+	char msg[4];
+	uint16_t dataLen = 0;
+	begin(&parser);
+	feed(&parser, "+IPD,0,6:abcdef+IPD,0,1:g");
+	CHECK(parser.pop(msg, sizeof(msg), &dataLen) == 0);
+	CHECK(strcmp(msg, "abc") == 0);
+	CHECK(dataLen == 6);
+	CHECK(popEquals(&parser, 0, "g"));
+
+	// The length counts the null characters in the data.
+	begin(&parser);
+	feed(&parser, "+IPD,1,3:\0\0x", 12);
+	CHECK(parser.pop(1, msg, sizeof(msg), &dataLen) == 1);
+	CHECK(dataLen == 3);
+}
+
+static void testRead()
+{
+	IPDParser parser;
+	char buf[16];
+
+	// The bytes are read across the frames, and the rest of a frame is kept.
+	begin(&parser);
+	feed(&parser, "+IPD,0,5:abcde+IPD,0,3:fgh+IPD,1,2:ij");
+	CHECK(parser.read(0, buf, 3) == 3);
+	CHECK(memcmp(buf, "abc", 3) == 0);
+	CHECK(parser.available(0) == 2);
+	CHECK(parser.read(0, buf, 4) == 4);
+	CHECK(memcmp(buf, "defg", 4) == 0);
+	CHECK(parser.read(0, buf, sizeof(buf)) == 1);
+	CHECK(buf[0] == 'h');
+	CHECK(parser.available(0) == 0);
+	CHECK(parser.read(0, buf, sizeof(buf)) == 0);
+	CHECK(parser.read(1, buf, sizeof(buf)) == 2);
+	CHECK(parser.read(4, buf, sizeof(buf)) == 0);
+
+	// The frame partly read can still be popped, and the ring takes the freed bytes.
+	char frame[32];
+	int n = 0;
+	begin(&parser);
+	while (parser.droppedFrames() == 0) {
+		sprintf(frame, "+IPD,0,10:frame%05d", n++);
+		feed(&parser, frame);
+	}
+	CHECK(parser.read(0, buf, 6) == 6);
+	CHECK(popEquals(&parser, 0, "0000"));
+	feed(&parser, "+IPD,0,10:frame99999");
+	CHECK(parser.droppedFrames() == 1);
+	for (int i = 1; i < n - 1; ++i)
+		CHECK(parser.read(0, buf, 10) == 10);
+	CHECK(parser.read(0, buf, sizeof(buf)) == 10);
+	CHECK(memcmp(buf, "frame99999", 10) == 0);
+
+	// Wrapping around the end of the ring
+	begin(&parser);
+	for (int i = 0; i < IPD_RING_SIZE / 12 + 3; ++i) {
+		feed(&parser, "+IPD,0,10:0123456789");
+		CHECK(parser.read(0, buf, 7) == 7);
+		CHECK(parser.read(0, buf + 7, 7) == 3);
+		CHECK(memcmp(buf, "0123456789", 10) == 0);
+	}
+	CHECK(parser.droppedFrames() == 0);
+}
+
+int main()
+{
+	testSplitFrame();
+	testBurst();
+	testBadLength();
+	testMissingColon();
+	testURC();
+	testOverflow();
+	testRead();
+
+	printf("%s: %d failed\n", failures ? "FAIL" : "PASS", failures);
+	return failures;
+}
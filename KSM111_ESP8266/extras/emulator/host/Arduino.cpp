@@ -0,0 +1,67 @@
+#include <time.h>
+
+#include "Arduino.h"
+
+ConsoleSerial Serial;
+
+void (*hostPinHook)(uint8_t pin, uint8_t value) = NULL;
+
+static unsigned long long nowMicros()
+{
+	static unsigned long long origin = 0;
+	struct timespec ts;
+	unsigned long long now;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+	if (origin == 0)
+		origin = now;
+
+	return now - origin;
+}
+
+unsigned long millis()
+{
+	return (unsigned long)(nowMicros() / 1000);
+}
+
+unsigned long micros()
+{
+	return (unsigned long)nowMicros();
+}
+
+void delay(unsigned long ms)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000L;
+	nanosleep(&ts, NULL);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+	struct timespec ts;
+
+	ts.tv_sec = us / 1000000;
+	ts.tv_nsec = (us % 1000000) * 1000L;
+	nanosleep(&ts, NULL);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+	(void)pin;
+	(void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+	if (hostPinHook)
+		hostPinHook(pin, value);
+}
+
+int digitalRead(uint8_t pin)
+{
+	(void)pin;
+	return LOW;
+}
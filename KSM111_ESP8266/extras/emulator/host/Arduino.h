@@ -0,0 +1,48 @@
+/**
+ * @file Arduino.h
+ * @brief The host version of the Arduino core used by the libraries.
+ *
+ * The time is the real time of the host, so the measured latencies are real.
+ */
+#ifndef _HOST_ARDUINO_H_
+#define _HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Print.h"
+#include "Stream.h"
+#include "HardwareSerial.h"
+
+#define LOW    0
+#define HIGH   1
+#define INPUT  0
+#define OUTPUT 1
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define memcpy_P memcpy
+#define F(str) (str)
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+/**
+ * @brief The pins do nothing on the host, except calling <tt>hostPinHook</tt>.
+ */
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+/**
+ * @brief Called by <tt>digitalWrite()</tt>. ESP8266Emulator sets it to emulate the RST pin.
+ */
+extern void (*hostPinHook)(uint8_t pin, uint8_t value);
+
+#endif // _HOST_ARDUINO_H_
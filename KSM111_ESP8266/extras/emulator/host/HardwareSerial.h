@@ -0,0 +1,36 @@
+/**
+ * @file HardwareSerial.h
+ * @brief The host version of class HardwareSerial of Arduino.
+ *
+ * <tt>begin()</tt> and <tt>end()</tt> are virtual, so ESP8266Emulator can be
+ * passed to the constructors taking <tt>HardwareSerial *</tt>.
+ */
+#ifndef _HOST_HARDWARE_SERIAL_H_
+#define _HOST_HARDWARE_SERIAL_H_
+
+#include "Stream.h"
+
+class HardwareSerial : public Stream
+{
+	public:
+		virtual void begin(unsigned long baudrate) { (void)baudrate; }
+		virtual void end() {}
+		operator bool() { return true; }
+};
+
+/**
+ * @brief The console. It writes to stdout and reads nothing.
+ */
+class ConsoleSerial : public HardwareSerial
+{
+	public:
+		int available() { return 0; }
+		int read() { return -1; }
+		int peek() { return -1; }
+		size_t write(uint8_t c) { return fputc(c, stdout) == EOF ? 0 : 1; }
+		using Print::write;
+};
+
+extern ConsoleSerial Serial;
+
+#endif // _HOST_HARDWARE_SERIAL_H_
@@ -0,0 +1,58 @@
+/**
+ * @file Print.h
+ * @brief The host version of class Print of Arduino.
+ */
+#ifndef _HOST_PRINT_H_
+#define _HOST_PRINT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DEC 10
+#define HEX 16
+
+class Print
+{
+	public:
+		virtual ~Print() {}
+
+		virtual size_t write(uint8_t c) = 0;
+		virtual size_t write(const uint8_t *buffer, size_t size)
+		{
+			size_t n = 0;
+
+			while (size--)
+				n += write(*buffer++);
+			return n;
+		}
+		size_t write(const char *str) { return write((const uint8_t *)str, strlen(str)); }
+		size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+		virtual void flush() {}
+
+		size_t print(const char *str) { return write(str); }
+		size_t print(char c) { return write((uint8_t)c); }
+		size_t print(int n, int base = DEC) { return print((long)n, base); }
+		size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+		size_t print(long n, int base = DEC)
+		{
+			char buf[24];
+
+			snprintf(buf, sizeof(buf), base == HEX ? "%lX" : "%ld", n);
+			return write(buf);
+		}
+		size_t print(unsigned long n, int base = DEC)
+		{
+			char buf[24];
+
+			snprintf(buf, sizeof(buf), base == HEX ? "%lX" : "%lu", n);
+			return write(buf);
+		}
+
+		size_t println() { return write("\r\n"); }
+		template <class T> size_t println(T value) { return print(value) + println(); }
+		template <class T> size_t println(T value, int base) { return print(value, base) + println(); }
+};
+
+#endif // _HOST_PRINT_H_
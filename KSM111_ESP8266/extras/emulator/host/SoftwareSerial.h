@@ -0,0 +1,25 @@
+/**
+ * @file SoftwareSerial.h
+ * @brief The host version of class SoftwareSerial of Arduino. It's never connected.
+ */
+#ifndef _HOST_SOFTWARE_SERIAL_H_
+#define _HOST_SOFTWARE_SERIAL_H_
+
+#include "Stream.h"
+
+class SoftwareSerial : public Stream
+{
+	public:
+		SoftwareSerial(int rxPin, int txPin) { (void)rxPin; (void)txPin; }
+
+		void begin(long baudrate) { (void)baudrate; }
+		void end() {}
+		int available() { return 0; }
+		int read() { return -1; }
+		int peek() { return -1; }
+		size_t write(uint8_t c) { (void)c; return 1; }
+		using Print::write;
+		operator bool() { return true; }
+};
+
+#endif // _HOST_SOFTWARE_SERIAL_H_
@@ -0,0 +1,18 @@
+/**
+ * @file Stream.h
+ * @brief The host version of class Stream of Arduino.
+ */
+#ifndef _HOST_STREAM_H_
+#define _HOST_STREAM_H_
+
+#include "Print.h"
+
+class Stream : public Print
+{
+	public:
+		virtual int available() = 0;
+		virtual int read() = 0;
+		virtual int peek() = 0;
+};
+
+#endif // _HOST_STREAM_H_
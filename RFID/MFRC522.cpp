@@ -10,8 +10,32 @@
 
 #include "MFRC522.h"
 
+volatile bool MFRC522::_irqFired = false;
+
+/* The registers only changed by the driver, so their values are known
+ * without reading them. The others, like ComIrqReg, FIFOLevelReg, and
+ * Status2Reg, are changed by the RC522 and always read.
+ */
+static int8_t shadowSlot(uint8_t regAddr)
+{
+	switch (regAddr) {
+	case ComIEnReg:     return 0;
+	case DivIEnReg:     return 1;
+	case BitFramingReg: return 2;
+	case ModeReg:       return 3;
+	case TxControlReg:  return 4;
+	case TxASKReg:      return 5;
+	case TModeReg:      return 6;
+	default:            return -1;
+	}
+}
+
 uint8_t MFRC522::pcdReadReg(uint8_t regAddr)
 {
+	int8_t slot = shadowSlot(regAddr);
+	if (slot >= 0 && (_shadowValid & (1 << slot)))
+		return _shadow[slot];
+
 	unsigned char buff[2];
 	buff[0] = ((regAddr << 1) & 0x7E) | 0x80;	// Set bit 7 for reading
 	buff[1] = 0x00;
@@ -20,11 +44,25 @@ uint8_t MFRC522::pcdReadReg(uint8_t regAddr)
 	SPI.transfer(buff, 2);
 	digitalWrite(_selectPin, HIGH);
 
+	if (slot >= 0) {
+		_shadow[slot] = buff[1];
+		_shadowValid |= 1 << slot;
+	}
+
 	return (uint8_t)buff[1];
 }
 
 void MFRC522::pcdWriteReg(uint8_t regAddr, uint8_t value)
 {
+	int8_t slot = shadowSlot(regAddr);
+	if (slot >= 0) {
+		// The register already has the value.
+		if ((_shadowValid & (1 << slot)) && _shadow[slot] == value)
+			return;
+		_shadow[slot] = value;
+		_shadowValid |= 1 << slot;
+	}
+
 	unsigned char buff[2];
 	buff[0] = ((regAddr << 1) & 0x7E);	// Clear bit 7 for write
 	buff[1] = (unsigned char)value;
@@ -34,6 +72,35 @@ void MFRC522::pcdWriteReg(uint8_t regAddr, uint8_t value)
 	digitalWrite(_selectPin, HIGH);
 }
 
+/* The address byte is followed by the data bytes in one chip-select window.
+ */
+void MFRC522::pcdWriteBurst(uint8_t regAddr, const uint8_t *buf, uint8_t len)
+{
+	digitalWrite(_selectPin, LOW);
+	SPI.transfer((regAddr << 1) & 0x7E);
+	while (len--)
+		SPI.transfer(*buf++);
+	digitalWrite(_selectPin, HIGH);
+}
+
+/* Each byte sent is the address of the next read, and the value
+ * comes back in the following byte. A 0 ends the reading.
+ */
+void MFRC522::pcdReadBurst(uint8_t regAddr, uint8_t *buf, uint8_t len)
+{
+	uint8_t addr = ((regAddr << 1) & 0x7E) | 0x80;
+
+	if (len == 0)
+		return;
+
+	digitalWrite(_selectPin, LOW);
+	SPI.transfer(addr);
+	while (--len)
+		*buf++ = SPI.transfer(addr);
+	*buf = SPI.transfer(0x00);
+	digitalWrite(_selectPin, HIGH);
+}
+
 void MFRC522::pcdSetBitMask(uint8_t regAddr, uint8_t mask)
 {
 	uint8_t tmp = pcdReadReg(regAddr);
@@ -51,6 +118,7 @@ void MFRC522::pcdClearBitMask(uint8_t regAddr, uint8_t mask)
 void MFRC522::pcdReset(void)
 {
 	pcdWriteReg(CommandReg, PCD_SOFTRESET);
+	_shadowValid = 0;	// All the registers are reset.
 }
 
 void MFRC522::pcdInit(void)
@@ -79,9 +147,49 @@ void MFRC522::begin(void)
 	pcdInit();
 }
 
-uint8_t MFRC522::commWithPICC(uint8_t cmd, uint8_t *inBuf, uint8_t inBytes, uint8_t *outBuf, uint8_t *outBits)
+bool MFRC522::beginIRQ(int irqPin)
+{
+	if (digitalPinToInterrupt(irqPin) == NOT_AN_INTERRUPT)
+		return false;
+
+	pinMode(irqPin, INPUT);
+	attachInterrupt(digitalPinToInterrupt(irqPin), irqHandler, FALLING);
+	_irqPin = irqPin;
+
+	return true;
+}
+
+void MFRC522::irqHandler(void)
+{
+	_irqFired = true;
+}
+
+/* The IRQ pin is the OR of the enabled bits in ComIrqReg and DivIrqReg.
+ * Set IRqInv (ComIEnReg bit 7) for active low, and IRQPushPull (DivIEnReg bit 7).
+ * The caller clears the irq bits after this, which makes the pin high,
+ * so the next falling edge is made by the command.
+ */
+void MFRC522::pcdArmIRQ(uint8_t comIEn, uint8_t divIEn)
+{
+	pcdWriteReg(ComIEnReg, 0x80 | comIEn);
+	pcdWriteReg(DivIEnReg, 0x80 | divIEn);
+	_irqFired = false;
+}
+
+bool MFRC522::pcdWaitIRQ(void)
 {
-	uint8_t waitFor, status;
+	unsigned long start = millis();
+
+	while (!_irqFired)
+		if (millis() - start > PCD_IRQ_TIMEOUT)
+			return false;
+
+	return true;
+}
+
+void MFRC522::commWithPICCStart(uint8_t cmd, uint8_t *inBuf, uint8_t inBytes)
+{
+	uint8_t waitFor;
 
 	switch(cmd) {
 	case PCD_AUTHENT:
@@ -95,33 +203,47 @@ uint8_t MFRC522::commWithPICC(uint8_t cmd, uint8_t *inBuf, uint8_t inBytes, uint
 	}
 
 	pcdWriteReg(CommandReg, PCD_IDLE);	// Stop the active commands
-	pcdClearBitMask(ComIrqReg, 0x80);	// Clear all irq bits
-	pcdSetBitMask(FIFOLevelReg, 0x80);	// Flush the FIFO buffer
+	if (_irqPin >= 0)
+		pcdArmIRQ(waitFor | 0x01, 0x00);	// The command or the timer
+	pcdWriteReg(ComIrqReg, 0x7F);	// Clear all irq bits (Set1 is 0)
+	pcdWriteReg(FIFOLevelReg, 0x80);	// Flush the FIFO buffer
 	// Write data to FIFO buffer
-	for (int in = 0; in < inBytes; ++in)
-		pcdWriteReg(FIFODataReg, inBuf[in]);
+	pcdWriteBurst(FIFODataReg, inBuf, inBytes);
 	pcdWriteReg(CommandReg, cmd);	// Execute the command
 	if (cmd == PCD_TRANSCEIVE)
 		// Start the transmission of data
 		pcdSetBitMask(BitFramingReg, 0x80);
 
-	// Wait for the interrupt for 30 ms.
-	uint8_t i = 150, irq;
-	do {
-		// Check the irq every 200us.
-		delayMicroseconds(200);
+	_commCmd = cmd;
+	_commWaitFor = waitFor;
+	_commStart = millis();
+}
+
+uint8_t MFRC522::pollPICC(uint8_t *outBuf, uint8_t *outBits)
+{
+	uint8_t status, irq = 0;
+
+	// Without the IRQ pin, the irq bits are checked at each call.
+	if (_irqPin < 0 || _irqFired)
 		irq = pcdReadReg(ComIrqReg);
-		--i;
-	} while ((i != 0) && (!(irq & 0x01)) && (!(irq & waitFor)));
+	if (!(irq & 0x01) && !(irq & _commWaitFor)) {
+		// The timer of the PCD ends the command before PCD_IRQ_TIMEOUT,
+		// so an edge without the bits or no end means the PCD doesn't respond.
+		if (!_irqFired && millis() - _commStart <= PCD_IRQ_TIMEOUT)
+			return STATUS_BUSY;
+		status = STATUS_PCD_NO_RESPONSE;
+	} else if (irq & 0x01)
+		status = STATUS_TIMEOUT;	// The timer ended it: no PICC answered.
+	else
+		status = STATUS_OK;
 
 	// Stop the transmission of data
 	pcdClearBitMask(BitFramingReg, 0x80);
 
-	if ((i != 0) && (!(irq & 0x01))) {
+	if (status == STATUS_OK) {
 		uint8_t err = pcdReadReg(ErrorReg);
 		if (!(err & 0x11)) {
-			status = STATUS_OK;
-			if (cmd == PCD_TRANSCEIVE) {
+			if (_commCmd == PCD_TRANSCEIVE) {
 				uint8_t fifoBytes, lastBits;
 				fifoBytes = pcdReadReg(FIFOLevelReg);
 				lastBits = pcdReadReg(ControlReg) & 0x07;	// Get the number of vaild bits in the last received byte.
@@ -135,22 +257,30 @@ uint8_t MFRC522::commWithPICC(uint8_t cmd, uint8_t *inBuf, uint8_t inBytes, uint
 				if (fifoBytes > MAXRLEN) fifoBytes = MAXRLEN;
 
 				// Read data from FIFO buffer
-				for (int out = 0; out < fifoBytes; ++out)
-					outBuf[out] = pcdReadReg(FIFODataReg);
+				pcdReadBurst(FIFODataReg, outBuf, fifoBytes);
 			}
 		} else
 			status = STATUS_ERROR;
 
 		if (err & 0x08)
 			status = STATUS_COLLISION;
-	} else {
-		if (i == 0) status = STATUS_PCD_NO_RESPONSE;
-		else        status = STATUS_TIMEOUT;
 	}
 
 	return status;
 }
 
+uint8_t MFRC522::commWithPICC(uint8_t cmd, uint8_t *inBuf, uint8_t inBytes, uint8_t *outBuf, uint8_t *outBits)
+{
+	uint8_t status;
+
+	commWithPICCStart(cmd, inBuf, inBytes);
+	while ((status = pollPICC(outBuf, outBits)) == STATUS_BUSY)
+		if (_irqPin < 0)
+			delayMicroseconds(200);	// Check the irq every 200us.
+
+	return status;
+}
+
 uint8_t MFRC522::piccRequest(uint8_t req_cmd, uint8_t *ATQA)
 {
 	uint8_t status, receiveBits, buff[MAXRLEN];
@@ -168,6 +298,26 @@ uint8_t MFRC522::piccRequest(uint8_t req_cmd, uint8_t *ATQA)
 	return status;
 }
 
+void MFRC522::piccRequestStart(uint8_t req_cmd)
+{
+	// PICC request command has 7 bits in a short frame.
+	pcdWriteReg(BitFramingReg, 0x07);
+	commWithPICCStart(PCD_TRANSCEIVE, &req_cmd, 1);
+}
+
+uint8_t MFRC522::pollRequest(uint8_t *ATQA)
+{
+	uint8_t status, receiveBits, buff[MAXRLEN];
+
+	status = pollPICC(buff, &receiveBits);
+	if ((status == STATUS_OK) && (receiveBits == 16)) {
+		ATQA[0] = buff[0];
+		ATQA[1] = buff[1];
+	}
+
+	return status;
+}
+
 uint8_t MFRC522::piccAnticoll(uint8_t cascadeLv, uint8_t *sn)
 {
 	uint8_t status, buff[MAXRLEN], collbits = 0, i = 0, receiveBits, sn_BCC = 0;
@@ -217,7 +367,9 @@ uint8_t MFRC522::piccSelect(uint8_t cascadeLv, uint8_t *sn)
 		buf[i+2] = sn[i];
 		buf[6]  ^= sn[i];
 	}
-	calculateCRC(buf, 7, &buf[7]);	// Attach CRC_A at byte 7 and 8
+	// Attach CRC_A at byte 7 and 8
+	if (calculateCRC(buf, 7, &buf[7]) != STATUS_OK)
+		return STATUS_PCD_NO_RESPONSE;
 	pcdClearBitMask(Status2Reg, 0x80); // Disable encrypted communication
 
 	status = commWithPICC(PCD_TRANSCEIVE, buf, 9, buf, &receivedBits);
@@ -240,24 +392,50 @@ uint8_t MFRC522::piccHalt()
 	return commWithPICC(PCD_TRANSCEIVE, buff, 2, buff, &outBits);
 }
 
-void MFRC522::calculateCRC(uint8_t *inBuf, uint8_t inBytes, uint8_t *CRCBuf)
+void MFRC522::piccHaltStart()
+{
+	uint8_t buff[2];
+
+	buff[0] = PICC_HALT;
+	buff[1] = 0x00;
+	commWithPICCStart(PCD_TRANSCEIVE, buff, 2);
+}
+
+uint8_t MFRC522::calculateCRC(uint8_t *inBuf, uint8_t inBytes, uint8_t *CRCBuf)
 {
 	uint8_t irq, i;
-	pcdClearBitMask(DivIrqReg, 0x04);	// Clear CRCIRq bit
+
+	if (_softwareCRC) {
+		uint16_t crc = crcA(inBuf, inBytes);
+		CRCBuf[0] = (uint8_t)crc;
+		CRCBuf[1] = (uint8_t)(crc >> 8);
+		return STATUS_OK;
+	}
+
 	pcdWriteReg(CommandReg, PCD_IDLE);	// Stop all active command
-	pcdSetBitMask(FIFOLevelReg, 0x80);	// Flush FIFO buffer
-	for (i = 0; i < inBytes; ++i)
-		pcdWriteReg(FIFODataReg, inBuf[i]);
+	if (_irqPin >= 0)
+		pcdArmIRQ(0x00, 0x04);	// CRCIRq only
+	pcdWriteReg(DivIrqReg, 0x04);	// Clear CRCIRq bit (Set2 is 0)
+	pcdWriteReg(FIFOLevelReg, 0x80);	// Flush FIFO buffer
+	pcdWriteBurst(FIFODataReg, inBuf, inBytes);
 	pcdWriteReg(CommandReg, PCD_CALCCRC);	// Calcuate CRC
 	// Wait for PCD
-	i = 0xFF;
-	do {
-		irq = pcdReadReg(DivIrqReg);
-		--i;
-	} while ((i != 0) && !(irq & 0x04));
+	if (_irqPin >= 0) {
+		if (!pcdWaitIRQ())
+			return STATUS_PCD_NO_RESPONSE;
+	} else {
+		i = 0xFF;
+		do {
+			irq = pcdReadReg(DivIrqReg);
+			--i;
+		} while ((i != 0) && !(irq & 0x04));
+		if (!(irq & 0x04))
+			return STATUS_PCD_NO_RESPONSE;
+	}
 	// Get the result of CRC
 	CRCBuf[0] = pcdReadReg(CRCResultRegL);
 	CRCBuf[1] = pcdReadReg(CRCResultRegM);
+	return STATUS_OK;
 }
 
 /* Switch on the antenna on the MFRC522 module.
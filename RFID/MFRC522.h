@@ -17,6 +17,34 @@
 #define FIFOLEN 64	// 64 bytes
 #define MAXRLEN 18
 
+/**
+ * @brief The time to wait for a command of the RC522 in milliseconds.
+ * The timer of the RC522 ends a command in 25 ms if the PICC doesn't answer,
+ * so it's only reached if the RC522 doesn't respond.
+ */
+#ifndef PCD_IRQ_TIMEOUT
+#define PCD_IRQ_TIMEOUT 30
+#endif
+
+/* If the CRC_A should be calculated by the MF-RC522 instead of the MCU by default,
+ * uncomment the next line. It can still be changed by MFRC522::setSoftwareCRC(). */
+// #define MFRC522_HW_CRC
+
+/* If crcA() should look up a 512-byte table instead of shifting each byte,
+ * uncomment the next line. */
+// #define MFRC522_CRC_TABLE
+
+#ifdef MFRC522_CRC_TABLE
+ #ifdef __AVR__
+  #include <avr/pgmspace.h>
+  #define CRCA_TABLE_MEM PROGMEM
+  #define crcATableRead(p) pgm_read_word(p)
+ #else
+  #define CRCA_TABLE_MEM
+  #define crcATableRead(p) (*(p))
+ #endif
+#endif
+
 /* Command of MFRC522 */
 #define PCD_IDLE       0x00
 #define PCD_CALCCRC    0x03
@@ -26,6 +54,7 @@
 
 /* Command of Mifare One */
 #define PICC_REQIDL      0x26
+#define PICC_REQALL      0x52
 #define PICC_HALT        0x50
 #define PICC_CASCADE_Lv1 0x93
 #define PICC_CASCADE_Lv2 0x95
@@ -37,6 +66,7 @@
 /** @{ */
 #define CommandReg     0x01
 #define ComIEnReg      0x02
+#define DivIEnReg      0x03
 #define ComIrqReg      0x04
 #define DivIrqReg      0x05
 #define ErrorReg       0x06
@@ -63,6 +93,79 @@
 #define STATUS_ERROR           0x02
 #define STATUS_COLLISION       0x03
 #define STATUS_PCD_NO_RESPONSE 0x04
+#define STATUS_BUSY            0x05	// The command started by commWithPICCStart() isn't done
+
+/**
+ * @brief Calculate the entry of the CRC_A table for a byte at compile time.
+ * @param crc The byte
+ * @param bits The number of the bits left
+ */
+constexpr uint16_t crcATableEntry(uint16_t crc, uint8_t bits = 8)
+{
+	return bits == 0 ? crc :
+		crcATableEntry((crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1, bits - 1);
+}
+
+#ifdef MFRC522_CRC_TABLE
+/**
+ * @brief The CRC_A table with an entry for each of the bytes <tt>I</tt>.
+ * It's a template so that the table is defined once in the header.
+ */
+template<uint16_t... I>
+struct CRCATable
+{
+	static const uint16_t entries[sizeof...(I)];
+};
+
+template<uint16_t... I>
+const uint16_t CRCATable<I...>::entries[sizeof...(I)] CRCA_TABLE_MEM = { crcATableEntry(I)... };
+
+/**
+ * @brief Make <tt>CRCATable<0, 1, ..., N-1></tt>.
+ */
+template<uint16_t N, uint16_t... I>
+struct CRCATableOf : CRCATableOf<N - 1, N - 1, I...> {};
+
+template<uint16_t... I>
+struct CRCATableOf<0, I...>
+{
+	typedef CRCATable<I...> type;
+};
+#endif
+
+/**
+ * @brief Calculate the CRC_A of ISO/IEC 14443-3.
+ *
+ * The polynomial is x^16 + x^12 + x^5 + 1, reflected, with the preset value 6363h
+ * and no final XOR, the same as ModeReg 0x3D of the RC522.
+ * The bytes are processed one by one without a table,
+ * or by the table of crcATableEntry() if MFRC522_CRC_TABLE is defined.
+ *
+ * @param data The bytes to be calculated.
+ * @param len The number of bytes.
+ * @return The CRC_A. The low byte is sent first.
+ */
+static inline uint16_t crcA(const uint8_t *data, uint8_t len)
+{
+	uint16_t crc = 0x6363;
+
+#ifdef MFRC522_CRC_TABLE
+	const uint16_t *table = CRCATableOf<256>::type::entries;
+
+	while (len--)
+		crc = (crc >> 8) ^ crcATableRead(&table[(uint8_t)crc ^ *data++]);
+#else
+	uint8_t ch;
+
+	while (len--) {
+		ch = *data++ ^ (uint8_t)crc;
+		ch ^= ch << 4;
+		crc = (crc >> 8) ^ ((uint16_t)ch << 8) ^ ((uint16_t)ch << 3) ^ (ch >> 4);
+	}
+#endif
+
+	return crc;
+}
 
 /**
  * @class MFRC522 RFID/MFRC522.h "MFRC522.h"
@@ -85,7 +188,13 @@ class MFRC522
 		 * @param resetPowerDownPin Specify the pin number of Arduino which is connected to the reset pin of the MF-RC522 module.
 		 */
 		MFRC522(int selectPin, int resetPowerDownPin) :
-			_selectPin(selectPin), _resetPowerDownPin(resetPowerDownPin) {}
+			_selectPin(selectPin), _resetPowerDownPin(resetPowerDownPin), _irqPin(-1),
+			_shadowValid(0), _commCmd(PCD_IDLE), _commWaitFor(0), _commStart(0),
+#ifdef MFRC522_HW_CRC
+			_softwareCRC(false) {}
+#else
+			_softwareCRC(true) {}
+#endif
 		/** @} */
 
 		/**
@@ -99,6 +208,36 @@ class MFRC522
 		 */
 		void begin(void);
 
+		/**
+		 * @brief Wait for the RC522 by its IRQ pin instead of polling its registers.
+		 *
+		 * The IRQ pin is driven push-pull and active low. Each command enables
+		 * only the interrupts it's waiting for, and the falling edge sets a flag,
+		 * so no SPI transfer happens until the command is done.<br />
+		 * A blocking command returns as soon as it's done instead of at the next
+		 * 200 us poll, and pollPICC() only checks the flag while the command runs.<br />
+		 * If there is no edge for PCD_IRQ_TIMEOUT ms, the command returns
+		 * STATUS_PCD_NO_RESPONSE.<br />
+		 * Only one MFRC522 can use the IRQ pin.
+		 *
+		 * @param irqPin The pin number of Arduino which is connected to the IRQ pin
+		 *        of the MF-RC522 module. It must support the external interrupt.
+		 * @return false if the pin doesn't support the external interrupt.
+		 *         The registers are still polled then.
+		 */
+		bool beginIRQ(int irqPin);
+
+		/**
+		 * @brief Choose who calculates the CRC_A of <tt>piccSelect()</tt>.
+		 *
+		 * The MCU with crcA() needs no SPI transfer, while the RC522 needs
+		 * the data written to its FIFO and the result read back.
+		 * It's the MCU unless MFRC522_HW_CRC is defined.
+		 *
+		 * @param software true for the MCU, false for the RC522.
+		 */
+		void setSoftwareCRC(bool software) { _softwareCRC = software; }
+
 		/**
 		 * @brief Reset the RC522 by command (soft reset).
 		 */
@@ -177,9 +316,55 @@ class MFRC522
 		 */
 		uint8_t piccHalt(void);
 
+		/**
+		 * @name Non-blocking commands
+		 * Start a command and return at once, then call the poll function until it
+		 * returns anything but STATUS_BUSY. The MCU is free while the PICC answers,
+		 * or while the timer of the RC522 runs out if there is no PICC, which takes 25 ms.<br />
+		 * No other command can be sent until the poll function is done.
+		 */
+		/** @{ */
+		/**
+		 * @brief Start the communication with the PICC.
+		 * @param cmd The command to be executed. Could be PCD_AUTHENT or PCD_TRANSCEIVE
+		 * @param inBuf The pointer to the input buffer. It's written to the FIFO before returning.
+		 * @param inBytes The size of the input buffer in bytes
+		 * @sa MFRC522::pollPICC()
+		 */
+		void commWithPICCStart(uint8_t cmd, uint8_t *inBuf, uint8_t inBytes);
+		/**
+		 * @brief Check the command started by <tt>commWithPICCStart()</tt>, and get the result if it's done.
+		 *
+		 * There is no SPI transfer before the IRQ pin falls if <tt>beginIRQ()</tt> is used.
+		 * Otherwise, a register is read by each call.
+		 *
+		 * @param outBuf [out] The pointer to the output buffer of MAXRLEN bytes
+		 * @param outBits [out] The size of the vaild data in the output buffer in bits
+		 * @return STATUS_BUSY, or the return value of <tt>commWithPICC()</tt>.
+		 */
+		uint8_t pollPICC(uint8_t *outBuf, uint8_t *outBits);
+		/**
+		 * @brief Start <tt>piccRequest()</tt>.
+		 * @param req_cmd The request command to the PICC. Could be PICC_REQIDL or PICC_REQALL.
+		 * @sa MFRC522::pollRequest()
+		 */
+		void piccRequestStart(uint8_t req_cmd);
+		/**
+		 * @brief Check the request started by <tt>piccRequestStart()</tt>.
+		 * @param ATQA [out] 2-byte Answer To Requset_A from the PICC
+		 * @return STATUS_BUSY, or the return value of <tt>piccRequest()</tt>.
+		 */
+		uint8_t pollRequest(uint8_t *ATQA);
+		/**
+		 * @brief Start <tt>piccHalt()</tt>. Check it by <tt>pollPICC()</tt>.
+		 */
+		void piccHaltStart(void);
+		/** @} */
+
 	private:
 		/**
 		 * @brief Communication with the PICC.
+		 * It's <tt>commWithPICCStart()</tt>, then <tt>pollPICC()</tt> until it's done.
 		 *
 		 * @param cmd The command to be executed. Could be PCD_AUTHENT or PCD_TRANSCEIVE
 		 * @param inBuf The pointer to the input buffer
@@ -197,16 +382,17 @@ class MFRC522
 		uint8_t commWithPICC(uint8_t cmd, uint8_t *inBuf, uint8_t inBytes, uint8_t *outBuf, uint8_t *outBits);
 
 		/**
-		 * @brief Ask PCD to calculate the CRC code.
+		 * @brief Calculate the CRC code.
 		 *
-		 * The PCD will calculate the CRC code from the <tt>inBuf</tt>, and
-		 * the 2-byte result will be stored to <tt>outBuf</tt>.
+		 * The CRC code of the <tt>inBuf</tt> is calculated by crcA(), or by the PCD
+		 * if <tt>setSoftwareCRC(false)</tt>, and the 2-byte result will be stored to <tt>outBuf</tt>.
 		 *
 		 * @param inBuf The pointer to a buffer storing the data to be calculated.
 		 * @param inBytes The data length of <tt>inBuf</tt> in bytes.
 		 * @param outBuf [out] The pointer to a buffer to store 2-byte CRC result.
+		 * @return STATUS_OK, or STATUS_PCD_NO_RESPONSE if the PCD didn't finish.
 		 */
-		void calculateCRC(uint8_t *inBuf, uint8_t inBytes, uint8_t *outBuf);
+		uint8_t calculateCRC(uint8_t *inBuf, uint8_t inBytes, uint8_t *outBuf);
 
 		/**
 		 * @name Register operations
@@ -215,12 +401,14 @@ class MFRC522
 		/** @{ */
 		/**
 		 * @brief Set the specified bits of a register of RC522.
+		 * It's a single write if the register is in the shadow.
 		 * @param regAddr Specify the address of a register.
 		 * @param mask    Specify which bits will be set.
 		 */
 		void pcdSetBitMask (uint8_t regAddr, uint8_t mask);
 		/**
 		 * @brief Clear the specifed bits of a register of RC522.
+		 * It's a single write if the register is in the shadow.
 		 * @param regAddr Specify the address of a register.
 		 * @param mask    Specify which bits will be cleared.
 		 */
@@ -228,16 +416,61 @@ class MFRC522
 
 		/**
 		 * @brief Read a register value of RC522.
+		 * The registers only written by the driver are read from the shadow after the first time.
 		 * @param regAddr Specify the address of a register.
 		 * @return The value in the specified register.
 		 */
 		uint8_t pcdReadReg(uint8_t regAddr);
 		/**
 		 * @brief Write a value to a register of RC522.
+		 * It's skipped if the register in the shadow already has the value.
 		 * @param regAddr Specify the address of a register.
 		 * @param value   Specify the value to be written to the register.
 		 */
 		void pcdWriteReg(uint8_t regAddr, uint8_t value);
+
+		/**
+		 * @brief Write the bytes to a register of RC522 in one SPI transaction.
+		 * Mostly used for FIFODataReg.
+		 * @param regAddr Specify the address of a register.
+		 * @param buf     The bytes to be written in order.
+		 * @param len     The number of bytes.
+		 */
+		void pcdWriteBurst(uint8_t regAddr, const uint8_t *buf, uint8_t len);
+		/**
+		 * @brief Read the bytes from a register of RC522 in one SPI transaction.
+		 * Mostly used for FIFODataReg.
+		 * @param regAddr Specify the address of a register.
+		 * @param buf     [out] The bytes read in order.
+		 * @param len     The number of bytes.
+		 */
+		void pcdReadBurst(uint8_t regAddr, uint8_t *buf, uint8_t len);
+		/** @} */
+
+		/**
+		 * @name IRQ pin
+		 */
+		/** @{ */
+		/**
+		 * @brief Enable the interrupts of the next command and clear the flag.
+		 * @param comIEn The interrupts in ComIEnReg
+		 * @param divIEn The interrupts in DivIEnReg
+		 */
+		void pcdArmIRQ(uint8_t comIEn, uint8_t divIEn);
+		/**
+		 * @brief Wait for the falling edge of the IRQ pin up to PCD_IRQ_TIMEOUT ms.
+		 * @return false if timed out.
+		 */
+		bool pcdWaitIRQ(void);
+		/**
+		 * @brief The interrupt service routine of the IRQ pin.
+		 */
+		static void irqHandler(void);
+
+		/**
+		 * @brief Set by irqHandler()
+		 */
+		static volatile bool _irqFired;
 		/** @} */
 
 		/**
@@ -249,6 +482,37 @@ class MFRC522
 		 * @brief The pin number which is connected to the reset pin of MF-RC522 module.
 		 */
 		int _resetPowerDownPin;
+
+		/**
+		 * @brief The pin number which is connected to the IRQ pin of MF-RC522 module.
+		 * -1 if the registers are polled.
+		 */
+		int _irqPin;
+
+		/**
+		 * @name Register shadow
+		 * The last values of the registers only changed by the driver.
+		 * They are invalidated by pcdReset().
+		 */
+		/** @{ */
+		uint8_t _shadow[7];	///< Indexed by shadowSlot() in MFRC522.cpp
+		uint8_t _shadowValid;	///< The bit n is set if <tt>_shadow[n]</tt> is valid.
+		/** @} */
+
+		/**
+		 * @name The command in progress
+		 * Set by commWithPICCStart()
+		 */
+		/** @{ */
+		uint8_t _commCmd;
+		uint8_t _commWaitFor;	///< The bits in ComIrqReg which end the command
+		unsigned long _commStart;	///< The time in <tt>millis()</tt>
+		/** @} */
+
+		/**
+		 * @brief true if the CRC_A is calculated by crcA(). Set by setSoftwareCRC().
+		 */
+		bool _softwareCRC;
 };
 
 #endif // _MFRCC522_H_
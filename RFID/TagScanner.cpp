@@ -0,0 +1,140 @@
+#include <Arduino.h>
+#include <string.h>
+
+#include "TagScanner.h"
+
+/* The command of the RFID reader in progress */
+#define SCAN_IDLE    0
+#define SCAN_REQUEST 1
+#define SCAN_HALT    2
+
+TagScanner::TagScanner(RFID *rfid, unsigned long interval, unsigned long holdTime) :
+	_rfid(rfid), _handler(NULL), _interval(interval), _holdTime(holdTime),
+	_lastScan(0), _step(SCAN_IDLE), _lastSeen(0), _present(false), _pendingEnter(false)
+{
+	memset(&_event, 0, sizeof(_event));
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+void TagScanner::resetStats()
+{
+	memset(&_stats, 0, sizeof(_stats));
+	_stats.since = millis();
+}
+
+uint16_t TagScanner::scanRate() const
+{
+	unsigned long elapsed = millis() - _stats.since;
+
+	if (elapsed == 0)
+		return 0;
+	return (uint16_t)(_stats.scans * 1000UL / elapsed);
+}
+
+uint8_t TagScanner::missRate() const
+{
+	if (_stats.heldScans == 0)
+		return 0;
+	return (uint8_t)(_stats.misses * 100UL / _stats.heldScans);
+}
+
+void TagScanner::emit(uint8_t type, unsigned long time, TagEvent *event)
+{
+	_event.type = type;
+	_event.time = time;
+
+	if (type == TAG_ENTER)
+		++_stats.enters;
+	if (_handler)
+		_handler(&_event);
+	if (event)
+		*event = _event;
+}
+
+bool TagScanner::poll(TagEvent *event)
+{
+	uint8_t status, buff[MAXRLEN], bits, sn[TAG_SN_MAX], snBytes;
+	unsigned long now;
+
+	if (_pendingEnter) {
+		_pendingEnter = false;
+		emit(TAG_ENTER, _lastSeen, event);
+		return true;
+	}
+
+	if (_step == SCAN_HALT) {
+		if (_rfid->pollPICC(buff, &bits) == STATUS_BUSY)
+			return false;
+		_step = SCAN_IDLE;
+	}
+
+	if (_step == SCAN_IDLE) {
+		now = millis();
+		if (now - _lastScan < _interval)
+			return false;
+		_lastScan = now;
+
+		// PICC_REQALL also wakes up the tag halted by the last scan.
+		_rfid->piccRequestStart(PICC_REQALL);
+		_step = SCAN_REQUEST;
+		return false;
+	}
+
+	if ((status = _rfid->pollRequest(buff)) == STATUS_BUSY)
+		return false;
+	_step = SCAN_IDLE;
+	if (status == STATUS_OK && (status = _rfid->readTagSN(sn, &snBytes)) == STATUS_OK) {
+		// The halted tag doesn't answer, so the halt ends by the timer, too.
+		_rfid->piccHaltStart();
+		_step = SCAN_HALT;
+	}
+
+	return update(status, sn, snBytes, event);
+}
+
+bool TagScanner::update(uint8_t status, const uint8_t *sn, uint8_t snBytes, TagEvent *event)
+{
+	// The time the scan was started
+	unsigned long now = _lastScan;
+
+	++_stats.scans;
+	if (status != STATUS_OK && status != STATUS_TIMEOUT)
+		++_stats.errors;
+
+	if (_present) {
+		++_stats.heldScans;
+
+		if (status == STATUS_OK) {
+			if (snBytes == _event.snBytes && !memcmp(sn, _event.sn, snBytes)) {
+				_lastSeen = now;
+				return false;
+			}
+
+			// Another tag: the old one leaves, and the new one enters at the next poll().
+			emit(TAG_LEAVE, _lastSeen, event);
+			memcpy(_event.sn, sn, snBytes);
+			_event.snBytes = snBytes;
+			_lastSeen = now;
+			_pendingEnter = true;
+			return true;
+		}
+
+		++_stats.misses;
+		if (now - _lastSeen < _holdTime)
+			return false;
+
+		_present = false;
+		emit(TAG_LEAVE, _lastSeen, event);
+		return true;
+	}
+
+	if (status != STATUS_OK)
+		return false;
+
+	memcpy(_event.sn, sn, snBytes);
+	_event.snBytes = snBytes;
+	_lastSeen = now;
+	_present = true;
+	emit(TAG_ENTER, now, event);
+	return true;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file RFID/TagScanner.h
+ * @brief The header file of class TagScanner
+ */
+#ifndef _TAG_SCANNER_H_
+#define _TAG_SCANNER_H_
+
+#include <stdint.h>
+
+#include "RFID.h"
+
+/**
+ * @brief The default time between two scans in milliseconds.
+ */
+#ifndef TAG_SCAN_INTERVAL
+ #define TAG_SCAN_INTERVAL 50
+#endif
+
+/**
+ * @brief The default time in milliseconds a tag is still present after it was last read.
+ */
+#ifndef TAG_HOLD_TIME
+ #define TAG_HOLD_TIME 300
+#endif
+
+/**
+ * @brief The maximum length of the serial number in bytes.
+ */
+#define TAG_SN_MAX 10
+
+/**
+ * @name Tag event
+ */
+/** @{ */
+#define TAG_ENTER 1	// A tag comes into the field
+#define TAG_LEAVE 2	// The tag leaves the field
+/** @} */
+
+/**
+ * @struct TagEvent RFID/TagScanner.h <TagScanner.h>
+ * @brief A tag comes or leaves.
+ */
+typedef struct TagEvent {
+	uint8_t type;				///< TAG_ENTER or TAG_LEAVE
+	uint8_t snBytes;			///< The length of the serial number: 4, 7, or 10
+	uint8_t sn[TAG_SN_MAX];		///< The serial number
+	unsigned long time;			///< The time in <tt>millis()</tt>: when it's first read, or last read for TAG_LEAVE
+} TagEvent;
+
+/**
+ * @struct TagScanStats RFID/TagScanner.h <TagScanner.h>
+ * @brief The statistics of the scans since <tt>TagScanner::resetStats()</tt>.
+ */
+typedef struct TagScanStats {
+	unsigned long since;		///< The time of the reset in <tt>millis()</tt>
+	uint32_t scans;				///< The number of scans
+	uint32_t heldScans;			///< The number of scans while a tag is present
+	uint32_t misses;			///< The number of scans that didn't read the present tag
+	uint32_t errors;			///< The number of scans that found a tag but failed to read it
+	uint16_t enters;			///< The number of TAG_ENTER
+} TagScanStats;
+
+/**
+ * @brief The function called with a tag event by <tt>TagScanner::poll()</tt>.
+ */
+typedef void (*TagHandler)(const TagEvent *event);
+
+/**
+ * @class TagScanner RFID/TagScanner.h <TagScanner.h>
+ * @brief Scan the tags periodically and report when they come and leave.
+ *
+ * Each scan wakes up all the tags by PICC_REQALL, reads the serial number,
+ * and halts the tag, so a tag staying in the field is read by every scan.
+ * The request and the halt run over several calls of <tt>poll()</tt>, so
+ * <tt>loop()</tt> isn't held while the RC522 waits 25 ms for no tag to answer.
+ * Only reading the serial number of a tag which answered blocks.
+ * The tag is present until it isn't read for the hold time, so the missed
+ * scans and the tag bouncing at the edge of the field make no events.
+ */
+class TagScanner
+{
+	public:
+		/**
+		 * @param rfid The RFID reader, already started by <tt>begin()</tt>.
+		 * @param interval The time between two scans in milliseconds.
+		 * @param holdTime The time a tag is still present after it was last read, in milliseconds.
+		 */
+		TagScanner(RFID *rfid, unsigned long interval = TAG_SCAN_INTERVAL,
+				unsigned long holdTime = TAG_HOLD_TIME);
+
+		void setInterval(unsigned long interval) { _interval = interval; }
+		void setHoldTime(unsigned long holdTime) { _holdTime = holdTime; }
+
+		/**
+		 * @brief Set the function called with every event by <tt>poll()</tt>.
+		 * @param handler The function, or NULL to remove it.
+		 */
+		void onTag(TagHandler handler) { _handler = handler; }
+
+		/**
+		 * @brief Scan if the interval passed. Call it in every <tt>loop()</tt>.
+		 *
+		 * A scan is started by one call and checked by the next ones, so the
+		 * RFID reader can't be used by others while <tt>poll()</tt> is called.
+		 *
+		 * If another tag is read while a tag is present, TAG_LEAVE of the old one
+		 * is returned, and TAG_ENTER of the new one is returned by the next call.
+		 *
+		 * @param event [out] The event. Could be NULL if only the handler is used.
+		 * @return true if there is an event.
+		 */
+		bool poll(TagEvent *event = NULL);
+
+		/**
+		 * @brief Check if a tag is present.
+		 */
+		bool present() const { return _present; }
+		/**
+		 * @brief Get the last event, which is TAG_ENTER of the present tag if <tt>present()</tt>.
+		 */
+		const TagEvent &lastEvent() const { return _event; }
+
+		/**
+		 * @name Statistics
+		 */
+		/** @{ */
+		const TagScanStats &stats() const { return _stats; }
+		void resetStats();
+		/**
+		 * @brief Get the number of scans per second.
+		 */
+		uint16_t scanRate() const;
+		/**
+		 * @brief Get the percentage of the scans that didn't read the present tag.
+		 */
+		uint8_t missRate() const;
+		/** @} */
+
+	private:
+		/**
+		 * @brief Update the present tag by the result of a scan.
+		 * @param status The status of the reading. STATUS_TIMEOUT if there is no tag.
+		 * @return true if there is an event.
+		 */
+		bool update(uint8_t status, const uint8_t *sn, uint8_t snBytes, TagEvent *event);
+
+		/**
+		 * @brief Make the event, pass it to the handler, and copy it to <tt>event</tt>.
+		 */
+		void emit(uint8_t type, unsigned long time, TagEvent *event);
+
+		RFID *_rfid;
+		TagHandler _handler;
+		unsigned long _interval;
+		unsigned long _holdTime;
+		unsigned long _lastScan;
+		uint8_t _step;				///< The command in progress: SCAN_IDLE, SCAN_REQUEST, or SCAN_HALT
+		unsigned long _lastSeen;	///< The last time the present tag was read
+		bool _present;
+		bool _pendingEnter;			///< TAG_ENTER of _event is returned by the next poll()
+		TagEvent _event;
+		TagScanStats _stats;
+};
+
+#endif // _TAG_SCANNER_H_
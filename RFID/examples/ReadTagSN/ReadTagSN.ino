@@ -18,6 +18,9 @@
 // becasue we use SPI in master mode.
 #define SPI_SS   10
 #define MFRC522_RSTPD 9
+/* If the IRQ pin of MF-RC522 is wired, uncomment the next line.
+ * It must be an external interrupt pin, for example, 2 or 3 of UNO. */
+// #define MFRC522_IRQ 2
 
 RFID rfid(SPI_SS, MFRC522_RSTPD);
 
@@ -26,6 +29,9 @@ void setup()
 	SPI.begin();
 	SPI.beginTransaction(SPISettings(10000000L, MSBFIRST, SPI_MODE3));
 	rfid.begin();
+#ifdef MFRC522_IRQ
+	rfid.beginIRQ(MFRC522_IRQ);
+#endif
 
 	Serial.begin(9600);
 	while (!Serial)
@@ -0,0 +1,57 @@
+/* Print when a tag comes and leaves, instead of every time it's read.
+ * Input 's' to print the statistics of the scans.
+ */
+#include <SPI.h>
+#include <RFID.h>
+#include <TagScanner.h>
+
+// SPI_SS pin can be chosen by yourself
+// becasue we use SPI in master mode.
+#define SPI_SS   10
+#define MFRC522_RSTPD 9
+
+RFID rfid(SPI_SS, MFRC522_RSTPD);
+// Scan every 50 ms. A tag is present until it isn't read for 300 ms.
+TagScanner scanner(&rfid, 50, 300);
+
+void setup()
+{
+	SPI.begin();
+	SPI.beginTransaction(SPISettings(10000000L, MSBFIRST, SPI_MODE3));
+	rfid.begin();
+
+	Serial.begin(9600);
+	while (!Serial)
+		;
+
+	scanner.resetStats();
+}
+
+void printSN(const TagEvent *event)
+{
+	for (int i = 0; i < event->snBytes; ++i)
+		Serial.print(event->sn[i], HEX);
+}
+
+void loop()
+{
+	TagEvent event;
+
+	if (scanner.poll(&event)) {
+		Serial.print(event.time);
+		Serial.print(event.type == TAG_ENTER ? " Enter: " : " Leave: ");
+		printSN(&event);
+		Serial.println();
+	}
+
+	if (Serial.available() && Serial.read() == 's') {
+		Serial.print(scanner.scanRate());
+		Serial.print(" scans/s, ");
+		Serial.print(scanner.missRate());
+		Serial.print("% missed, ");
+		Serial.print(scanner.stats().errors);
+		Serial.print(" errors, ");
+		Serial.print(scanner.stats().enters);
+		Serial.println(" tags");
+	}
+}
@@ -0,0 +1,118 @@
+/*
+ * Check crcA() against the CRC_A vectors of ISO/IEC 14443-3.
+ * Build it with and without -DMFRC522_CRC_TABLE to check both ways of crcA().
+ *
+ * Usage: CRCATest
+ *
+ * Each failed check is printed with its line. The exit code is the number of failures.
+ */
+#include <stdio.h>
+
+#include "MFRC522.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+			++failures; \
+		} \
+	} while (0)
+
+/**
+ * @brief Calculate the CRC_A bit by bit, as the standard describes it.
+ */
+static uint16_t crcABitwise(const uint8_t *data, uint8_t len)
+{
+	uint16_t crc = 0x6363;
+
+	while (len--) {
+		crc ^= *data++;
+		for (int i = 0; i < 8; ++i)
+			crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+	}
+
+	return crc;
+}
+
+// The table is made at compile time. These are the entries of the reflected 0x8408.
+static_assert(crcATableEntry(0x00) == 0x0000, "crcATableEntry(0x00)");
+static_assert(crcATableEntry(0x01) == 0x1189, "crcATableEntry(0x01)");
+static_assert(crcATableEntry(0x80) == 0x8408, "crcATableEntry(0x80)");
+static_assert(crcATableEntry(0xFF) == 0x0F78, "crcATableEntry(0xFF)");
+
+static void testVectors()
+{
+	// Annex B of ISO/IEC 14443-3, HLTA, and RATS with 2 FSDIs
+	const uint8_t zero[] = { 0x00, 0x00 };
+	const uint8_t annexB[] = { 0x12, 0x34 };
+	const uint8_t halt[] = { PICC_HALT, 0x00 };
+	const uint8_t rats[] = { 0xE0, 0x80 };
+	const uint8_t rats5[] = { 0xE0, 0x50 };
+
+	CHECK(crcA(zero, 2) == 0x1EA0);
+	CHECK(crcA(annexB, 2) == 0xCF26);
+	CHECK(crcA(halt, 2) == 0xCD57);
+	CHECK(crcA(rats, 2) == 0x7331);
+	CHECK(crcA(rats5, 2) == 0xA5BC);
+	CHECK(crcA(zero, 0) == 0x6363);
+}
+
+static void testSelectFrame()
+{
+	// SELECT of cascade level 1 with the UID 12 34 56 78, as piccSelect() builds it
+	uint8_t buf[9] = { PICC_CASCADE_Lv1, 0x70, 0x12, 0x34, 0x56, 0x78, 0x00 };
+	uint16_t crc;
+
+	for (int i = 2; i < 6; ++i)
+		buf[6] ^= buf[i];
+	CHECK(buf[6] == 0x08);
+
+	crc = crcA(buf, 7);
+	CHECK(crc == 0xA23C);
+	CHECK(crc == crcABitwise(buf, 7));
+
+	// The CRC over the frame with its CRC appended is 0.
+	buf[7] = (uint8_t)crc;
+	buf[8] = (uint8_t)(crc >> 8);
+	CHECK(crcABitwise(buf, 9) == 0);
+}
+
+static void testAllBytes()
+{
+	uint8_t buf[2];
+
+	for (int i = 0; i < 256; ++i) {
+		buf[0] = i;
+		buf[1] = ~i;
+		CHECK(crcA(buf, 1) == crcABitwise(buf, 1));
+		CHECK(crcA(buf, 2) == crcABitwise(buf, 2));
+	}
+}
+
+static void testLong()
+{
+	uint8_t buf[MAXRLEN];
+
+	for (int i = 0; i < MAXRLEN; ++i)
+		buf[i] = i * 37 + 11;
+	for (int len = 0; len <= MAXRLEN; ++len)
+		CHECK(crcA(buf, len) == crcABitwise(buf, len));
+}
+
+int main()
+{
+#ifdef MFRC522_CRC_TABLE
+	printf("crcA() by the table\n");
+#else
+	printf("crcA() by the shifts\n");
+#endif
+	testVectors();
+	testSelectFrame();
+	testAllBytes();
+	testLong();
+
+	printf("%s: %d failed\n", failures ? "FAIL" : "PASS", failures);
+	return failures;
+}